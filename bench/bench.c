@@ -0,0 +1,375 @@
+// Benchmarks of cli.h: parsing command lines of 1 to 1M arguments and printing messages.
+//
+// Build the benchmark with the same macros as your program, e.g. on the heap and on the stack:
+//     cc -O2 -o bench bench/bench.c
+//     cc -O2 -DCLI_NOHEAP_IMPLEMENTATION -o bench_noheap bench/bench.c
+//     cc -O2 -DCLI_INDEX -DCLI_SIMD -mavx2 -o bench_index bench/bench.c
+//
+// Results are printed to stdout as CSV (see README.md), so runs of two versions can be compared:
+//     ./bench > bench_output.txt
+//
+// Options:
+//     --max-args=N  The largest command line (1000000 by default).
+//     --min-time=MS Repeat every benchmark for at least MS milliseconds (200 by default).
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define CLI_IMPLEMENTATION
+#include "../cli.h"
+
+#ifdef CLI_NOHEAP
+#define BENCH_MODE "noheap"
+#else
+#define BENCH_MODE "heap"
+#endif
+
+// Macros that change the parser, so that rows of different builds are not mixed up.
+static const char* bench_config(void) {
+    return ""
+#ifdef CLI_VIEWS
+           "+views"
+#endif
+#ifdef CLI_INDEX
+           "+index"
+#endif
+#ifdef CLI_SIMD
+           "+simd"
+#endif
+#ifdef CLI_SHORT_FLAGS
+           "+short_flags"
+#endif
+#ifdef CLI_COMPACT
+           "+compact"
+#endif
+        ;
+}
+
+static unsigned long long bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000u + (unsigned long long)now.tv_nsec;
+}
+
+// Cache misses of this process (perf_event_open(2) on Linux). If the counter is not available
+// (e.g. in a container), misses are reported as -1.
+static int bench_perf_fd = -1;
+
+static void bench_perf_open(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    bench_perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static void bench_perf_start(void) {
+#ifdef __linux__
+    if (bench_perf_fd >= 0) {
+        ioctl(bench_perf_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(bench_perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+static long long bench_perf_stop(void) {
+    long long misses = -1;
+#ifdef __linux__
+    if (bench_perf_fd >= 0) {
+        ioctl(bench_perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(bench_perf_fd, &misses, sizeof(misses)) != sizeof(misses)) {
+            misses = -1;
+        }
+    }
+#endif
+    return misses;
+}
+
+// A mix of arguments of a command line.
+enum BenchMix {
+    BenchMixOptions,
+    BenchMixArgs,
+    BenchMixMixed
+};
+
+static const char* const bench_mix_names[] = { "options", "args", "mixed" };
+
+// A command line with its strings in one buffer, like `argv` of main().
+struct BenchArgv {
+    int argc;
+    char** argv;
+    char* strings;
+};
+
+// Build `argc` arguments (with the executable file): program options, positional arguments or
+// a quarter of program options, a half of positional arguments and a quarter of command options.
+static struct BenchArgv bench_make_argv(int argc, enum BenchMix mix) {
+    struct BenchArgv result = { argc, malloc(((size_t)argc + 1) * sizeof(char*)), NULL };
+    result.strings = malloc((size_t)argc * 32);
+    if (result.argv == NULL || result.strings == NULL) {
+        fprintf(stderr, "Unable to allocate %d arguments.\n", argc);
+        exit(1);
+    }
+
+    char* next = result.strings;
+    result.argv[0] = next;
+    next += sprintf(next, "bench") + 1;
+    int options = mix == BenchMixOptions ? argc - 1 : mix == BenchMixArgs ? 0 : (argc - 1) / 4;
+    int args = mix == BenchMixOptions ? 0 : mix == BenchMixArgs ? argc - 1 : (argc - 1) / 2;
+    for (int i = 1; i < argc; i++) {
+        result.argv[i] = next;
+        if (i <= options) {
+            // Every fourth option is a flag, others have values.
+            next += (i % 4 ? sprintf(next, "--option-%d=%d", i % 64, i) : sprintf(next, "-v")) + 1;
+        } else if (i <= options + args) {
+            next += sprintf(next, "file-%d.txt", i) + 1;
+        } else {
+            next += sprintf(next, "--cmd-%d=%d", i % 16, i) + 1;
+        }
+    }
+    result.argv[argc] = NULL;
+    return result;
+}
+
+static void bench_free_argv(struct BenchArgv* argv) {
+    free(argv->argv);
+    free(argv->strings);
+}
+
+#ifndef CLI_NOHEAP
+// An allocator that counts allocations of a run that is not timed (see bench_count_allocations()).
+static size_t bench_allocations;
+
+static void* bench_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    bench_allocations++;
+    return malloc(size);
+}
+
+static void* bench_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    bench_allocations++;
+    return realloc(ptr, new_size);
+}
+
+static void bench_free(void* ctx, void* ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+static const CliAllocator bench_allocator = { NULL, bench_alloc, bench_realloc, bench_free };
+#endif // CLI_NOHEAP
+
+// Parsing functions of benchmarks: cli_reparse() reuses the block of previous iterations.
+enum BenchParse {
+    BenchParseFresh,
+    BenchParseReparse
+};
+
+#ifndef CLI_NOHEAP
+// Count allocations of a single iteration with the counting allocator, so that timed iterations
+// use the default allocator of cli_parse() and cli_reparse().
+static double bench_count_allocations(const struct BenchArgv* argv, enum BenchParse parse) {
+    Cli cli = { 0 };
+    enum CliError error;
+    if (parse == BenchParseReparse) {
+        // An iteration of cli_reparse() after the first one.
+        cli.allocator = bench_allocator;
+        error = cli_reparse(argv->argc, argv->argv, &cli);
+        bench_allocations = 0;
+        error = error ? error : cli_reparse(argv->argc, argv->argv, &cli);
+    } else {
+        bench_allocations = 0;
+        error = cli_parse_ex(argv->argc, argv->argv, &cli, &bench_allocator);
+    }
+    cli_free(&cli);
+    return error ? -1.0 : (double)bench_allocations;
+}
+#endif // CLI_NOHEAP
+
+#ifdef CLI_NOHEAP
+static const char* const bench_parse_names[] = { "cli_parse_noheap", "cli_reparse" };
+#else
+static const char* const bench_parse_names[] = { "cli_parse", "cli_reparse" };
+#endif
+
+static unsigned long long bench_min_ns = 200ull * 1000 * 1000;
+
+static void bench_print_header(void) {
+    printf("benchmark,mode,config,mix,args,iterations,ns_per_iteration,ns_per_arg,"
+           "args_per_second,allocations_per_iteration,cache_misses_per_iteration\n");
+}
+
+static void bench_print_row(
+    const char* benchmark, const char* mix, long long args, unsigned long long iterations,
+    unsigned long long ns, double allocations, long long misses
+) {
+    double per_iteration = (double)ns / (double)iterations;
+    printf(
+        "%s,%s,%s,%s,%lld,%llu,%.1f,%.3f,%.0f,%.2f,%.1f\n", benchmark, BENCH_MODE, bench_config(),
+        mix, args, iterations, per_iteration, args ? per_iteration / (double)args : 0.0,
+        args ? (double)args * 1e9 / per_iteration : 0.0, allocations,
+        misses < 0 ? -1.0 : (double)misses / (double)iterations
+    );
+    fflush(stdout);
+}
+
+static bool bench_parse(const struct BenchArgv* argv, enum BenchMix mix, enum BenchParse parse) {
+    Cli cli = { 0 };
+#ifdef CLI_NOHEAP
+    if (parse == BenchParseReparse) {
+        return true; // Stack parsing has no block to reuse.
+    }
+    const char** stack = malloc((size_t)argv->argc * sizeof(const char*));
+    if (stack == NULL) {
+        return false;
+    }
+#endif
+
+    unsigned long long iterations = 0;
+    unsigned long long elapsed = 0;
+    long long misses = 0;
+    size_t batch = 1;
+    while (elapsed < bench_min_ns) {
+        bench_perf_start();
+        unsigned long long start = bench_now_ns();
+        for (size_t i = 0; i < batch; i++) {
+            enum CliError error;
+#ifdef CLI_NOHEAP
+            error = cli_parse_noheap(argv->argc, argv->argv, &cli, stack);
+#else
+            if (parse == BenchParseReparse) {
+                error = cli_reparse(argv->argc, argv->argv, &cli);
+            } else {
+                error = cli_parse(argv->argc, argv->argv, &cli);
+                cli_free(&cli);
+            }
+#endif
+            if (error) {
+                return false;
+            }
+        }
+        elapsed += bench_now_ns() - start;
+        long long batch_misses = bench_perf_stop();
+        misses = misses < 0 || batch_misses < 0 ? -1 : misses + batch_misses;
+        iterations += batch;
+        batch *= 2;
+    }
+
+#ifdef CLI_NOHEAP
+    free(stack);
+    double allocations = 0;
+#else
+    cli_free(&cli);
+    double allocations = bench_count_allocations(argv, parse);
+#endif
+    bench_print_row(
+        bench_parse_names[parse], bench_mix_names[mix], argv->argc - 1, iterations, elapsed,
+        allocations, misses
+    );
+    return true;
+}
+
+// Printing macros with styles on and off. Messages go to /dev/null, so the terminal is not
+// measured.
+static void bench_print(void) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    int stderr_fd = dup(STDERR_FILENO);
+    if (null_fd < 0 || stderr_fd < 0) {
+        return;
+    }
+    dup2(null_fd, STDERR_FILENO);
+
+    const char* const benchmarks[] = { "cli_print_info", "cli_printf_info" };
+    for (int styled = 0; styled < 2; styled++) {
+        if (styled) {
+            cli_toggle_styles();
+        }
+        for (int b = 0; b < 2; b++) {
+            unsigned long long iterations = 0;
+            unsigned long long elapsed = 0;
+            size_t batch = 64;
+            bench_perf_start();
+            while (elapsed < bench_min_ns) {
+                unsigned long long start = bench_now_ns();
+                for (size_t i = 0; i < batch; i++) {
+                    if (b == 0) {
+                        cli_print_info("Info", "Processing a file.");
+                    } else {
+                        cli_printf_info("Info", "Processing a file (%s, %zu).", "file.txt", i);
+                    }
+                }
+                elapsed += bench_now_ns() - start;
+                iterations += batch;
+                batch *= 2;
+            }
+            long long misses = bench_perf_stop();
+
+            // Rows are written to stdout that is not redirected.
+            bench_print_row(
+                benchmarks[b], styled ? "styles_on" : "styles_off", 0, iterations, elapsed, 0,
+                misses
+            );
+        }
+        if (styled) {
+            cli_toggle_styles();
+        }
+    }
+
+    dup2(stderr_fd, STDERR_FILENO);
+    close(stderr_fd);
+    close(null_fd);
+}
+
+int main(int argc, char** argv) {
+    long long max_args = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--max-args=", 11) == 0) {
+            max_args = atoll(argv[i] + 11);
+        } else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+            bench_min_ns = (unsigned long long)atoll(argv[i] + 11) * 1000 * 1000;
+        } else {
+            fprintf(stderr, "Unknown option ('%s').\n", argv[i]);
+            return 1;
+        }
+    }
+
+    bench_perf_open();
+    bench_print_header();
+    for (long long args = 1; args <= max_args; args *= 10) {
+        for (int mix = BenchMixOptions; mix <= BenchMixMixed; mix++) {
+            struct BenchArgv command_line = bench_make_argv((int)args + 1, (enum BenchMix)mix);
+            for (int parse = BenchParseFresh; parse <= BenchParseReparse; parse++) {
+                if (!bench_parse(&command_line, (enum BenchMix)mix, (enum BenchParse)parse)) {
+                    fprintf(stderr, "Unable to parse %lld arguments.\n", args);
+                    return 1;
+                }
+            }
+            bench_free_argv(&command_line);
+        }
+    }
+    bench_print();
+    return 0;
+}
@@ -32,8 +32,8 @@
 // The behaviour and dependencies of this library can be configured with
 // defining these macros:
 //     CLI_NO_STDIO_H
-//         Do not include <stdio.h> (but fprintf() is still expected to be
-//         defined).
+//         Do not include <stdio.h> (but fprintf(), vfprintf() and vsnprintf()
+//         are still expected to be defined).
 //     CLI_NO_STDBOOL_H
 //         Do not use <stdbool.h>.
 //     CLI_NO_STYLES
@@ -42,9 +42,71 @@
 //     CLI_NOHEAP_IMPLEMENTATION
 //         Do not allocate arguments on the heap. For more information, see
 //         below.
+//     CLI_VIEWS
+//         Split options into names and values (see `CliOption`). Cannot be used
+//         with CLI_NOHEAP.
+//         CLI_SCHEMA() requires this macro.
+//     CLI_SIMD
+//         Use SSE2, AVX2 or NEON (if enabled for the target) to split options
+//         for CLI_VIEWS. Otherwise, bytes are checked one at a time.
+//     CLI_INDEX
+//         Build a hash table over program and command options for
+//         cli_get_option(), cli_has_flag() and typed accessors (e.g.
+//         cli_get_int()). Implies CLI_VIEWS.
+//     CLI_ENV
+//         Provide cli_load_env() that adds environment variables with a prefix
+//         to the index of CLI_INDEX (POSIX only). Implies CLI_INDEX.
+//     CLI_CONFIG
+//         Provide cli_load_config() that adds options of a `key=value` file to
+//         the index of CLI_INDEX (POSIX only). Implies CLI_INDEX.
+//     CLI_SHORT_FLAGS
+//         Record characters of short program options and their clusters (e.g.
+//         `-xvf`) for cli_flag().
+//     CLI_COMPACT
+//         Store 32-bit offsets of arguments instead of pointers in
+//         `CliArray.data` (see cli_at()). Cannot be used with CLI_NOHEAP or
+//         CLI_RESPONSE_FILES.
+//     CLI_STREAM
+//         Provide cli_read_args() and cli_stream_args() that read NUL-delimited
+//         arguments from a file descriptor (POSIX only). Cannot be used with
+//         CLI_NOHEAP or CLI_COMPACT.
+//     CLI_STREAM_BUFFER_SIZE = 65536
+//         A size of the buffer that cli_read_args() reads into. Longer
+//         arguments cannot be read.
+//     CLI_RESPONSE_FILES
+//         Replace `@path` arguments with arguments from the file `path` (POSIX
+//         only). Cannot be used with CLI_NOHEAP. For more information, see
+//         README.md.
+//
+//     CLI_WRITER
+//         Allow printing macros to write to a buffer (see `CliWriter`) instead
+//         of stderr (POSIX only).
+//     CLI_BATCH
+//         Provide cli_parse_batch() that parses many command lines on several
+//         threads (POSIX threads and GCC/Clang only). Cannot be used with
+//         CLI_NOHEAP.
+//     CLI_LOG_LEVEL = 0
+//         Compile out printing macros below this level together with their
+//         arguments: 0 for debug, 1 for info, 2 for error and 3 for none
+//         (values of `enum CliLevel`).
+//         Higher levels can be disabled at runtime (see cli_set_log_level()).
+//     CLI_LOG_RING
+//         Make printing macros push messages to a lock-free ring that is
+//         written to stderr by cli_log_flush() (POSIX and GCC/Clang only).
+//     CLI_LOG_RING_SIZE = 1024
+//         A number of messages in the ring (a power of two).
+//     CLI_LOG_RECORD_SIZE = 512
+//         A maximum length of a message in the ring. Longer messages are
+//         written to stderr directly.
+//
+//     CLI_STATS
+//         Count allocations, bytes and time of parsing in `Cli.stats` (see
+//         cli_stats_dump()). Time needs POSIX or C11 (otherwise, it is 0).
+//
+//     CLI_SIZE_T = size_t
+//         An unsigned type of `CliArray.length` and `CliArray.capacity`. If
+//         there are more arguments than it can count, cli_parse() fails.
 //
-//     CLI_DEFAULT_ARR_CAP = 5
-//         Default capacity for dynamic arrays (e.g. CliArray).
 //     CLI_ASSERT = assert
 //         An assert function. If not defined, assert() from <assert.h> is
 //         used.
@@ -88,6 +150,14 @@
 //     }
 //
 
+// On the heap, cli_parse() makes exactly one allocation of `argc - 1` items that
+// is shared by all arrays of `Cli`. If cli_parse() fails, the memory is already
+// released and calling cli_free() is optional.
+//
+// To parse many command lines, cli_reparse() reuses the allocation of a
+// previous parse and only grows it, so no allocations are made once it is
+// large enough.
+
 // It is possible to use cli.h without allocating CliArray.data on the heap.
 // For that, CLI_NOHEAP and/or CLI_NOHEAP_IMPLEMENTATION should be used.
 //
@@ -102,9 +172,8 @@
 // 3. If no heap allocations are made, it is not possible for cli.h to
 //    determine the capacity of the CliStackNode[] array. Thus, .capacity
 //    of CliArray should not be used.
-// 4. If you use cli_parse_noheap() instead of preparing variables manually,
-//    .next_unused of CliStackNode cannot be used either. It points to a local
-//    variable that becomes invalid after cli_parse_noheap() returns.
+// 4. If you use cli_parse_noheap(), .next_unused of CliArray points to
+//    `Cli.next_unused`, so the Cli should not be copied while it is used.
 
 #ifndef __CLI_H_
 #define __CLI_H_
@@ -117,15 +186,77 @@ extern "C" {
 #define CLI_NOHEAP
 #endif
 
+#if (defined(CLI_ENV) || defined(CLI_CONFIG)) && !defined(CLI_INDEX)
+#define CLI_INDEX
+#endif
+
+#if defined(CLI_INDEX) && !defined(CLI_VIEWS)
+#define CLI_VIEWS
+#endif
+
+// Options that do not come from the command line are loaded into layers of the index.
+#if defined(CLI_ENV) || defined(CLI_CONFIG)
+#define CLI_LAYERS
+#endif
+
+#if defined(CLI_VIEWS) && defined(CLI_NOHEAP)
+#error "CLI_VIEWS and CLI_INDEX are stored in the heap block of cli_parse() and cannot be used with CLI_NOHEAP."
+#endif
+
+#if defined(CLI_COMPACT) && (defined(CLI_NOHEAP) || defined(CLI_RESPONSE_FILES))
+#error "CLI_COMPACT cannot be used with CLI_NOHEAP or CLI_RESPONSE_FILES: arguments should be close to each other in memory."
+#endif
+
+#if defined(CLI_STREAM) && (defined(CLI_NOHEAP) || defined(CLI_COMPACT))
+#error "CLI_STREAM cannot be used with CLI_NOHEAP or CLI_COMPACT: arguments from a file descriptor are stored in separate chunks of the heap."
+#endif
+
+#if defined(CLI_RESPONSE_FILES) && defined(CLI_NOHEAP)
+#error "CLI_RESPONSE_FILES cannot be used with CLI_NOHEAP: `stack` is too small for arguments from files."
+#endif
+
+#if defined(CLI_BATCH) && (defined(CLI_NOHEAP) || !defined(__GNUC__))
+#error "CLI_BATCH requires the heap and __atomic builtins of GCC or Clang."
+#endif
+
+#if defined(CLI_LOG_RING) && !defined(__GNUC__)
+#error "CLI_LOG_RING requires __atomic builtins of GCC or Clang."
+#endif
+
+#ifdef CLI_NO_STDBOOL_H
+#ifndef __cplusplus
+typedef unsigned char bool;
+#define true  (bool)1
+#define false (bool)0
+#endif
+#else
+#include <stdbool.h>
+#endif // CLI_NO_STDBOOL_H
+
+#include <stddef.h>
+
+#include <string.h>
+
+// Escape sequences for CLI_RESET, CLI_BOLD and others (see cli_toggle_styles()).
+#define CLI_RESET_SEQ       "\033[0m"
+#define CLI_BOLD_SEQ        "\033[1m"
+#define CLI_DIM_SEQ         "\033[2m"
+#define CLI_FORE_RED_SEQ    "\033[31m"
+#define CLI_FORE_BRBLUE_SEQ "\033[94m"
+
 const char* CLI_RESET = "";
 const char* CLI_BOLD = "";
 const char* CLI_DIM = "";
 const char* CLI_FORE_RED = "";
 const char* CLI_FORE_BRBLUE = "";
 
+#ifndef CLI_SIZE_T
+#define CLI_SIZE_T size_t
+#endif
+
 #ifdef CLI_NOHEAP
 struct CliArray {
-    unsigned short length;
+    CLI_SIZE_T length;
     const char** stack;
     const char** data;
     // A pointer to a global (between `CliArray` instances) variable that points
@@ -136,18 +267,197 @@ struct CliArray {
     const char*** next_unused;
 };
 #else
+#ifdef CLI_VIEWS
+// An option split into parts. All pointers point to the original argument.
+//
+// For `--option=1`, `name` is "option" and `value` is "1".
+struct CliOption {
+    const char* name;
+    size_t name_length;
+    // NULL if the option has no '='.
+    const char* value;
+    size_t value_length;
+    // Either 1 (`-o`) or 2 (`--option`).
+    unsigned char dashes;
+#ifdef CLI_INDEX
+    // A value converted by the last typed accessor (e.g. cli_get_int()) and its
+    // kind (0 if the value is not converted).
+    unsigned char converted_kind;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+    } converted;
+#endif
+};
+#endif // CLI_VIEWS
+
+#ifdef CLI_COMPACT
+// An offset of an argument from `CliArray.base` (see cli_at()).
+typedef unsigned int CliItem;
+#else
+typedef const char* CliItem;
+#endif
+
 struct CliArray {
-    unsigned short length;
-    unsigned short capacity;
-    const char** data;
+    CLI_SIZE_T length;
+    CLI_SIZE_T capacity;
+    CliItem* data;
+#ifdef CLI_COMPACT
+    // The lowest address of arguments (the same for all arrays of `Cli`).
+    const char* base;
+#endif
+#ifdef CLI_VIEWS
+    // Options in the same order as `data`. Always NULL for `Cli.args`.
+    struct CliOption* options;
+#endif
 };
 #endif // CLI_NOHEAP
 
+/*
+ * Get an argument `i` of `array` (e.g. `cli_at(cli.args, 0)`). Without
+ * CLI_COMPACT, it is the same as `array.data[i]`.
+ */
+#ifdef CLI_COMPACT
+#define cli_at(array, i) ((array).base + (array).data[i])
+#else
+#define cli_at(array, i) ((array).data[i])
+#endif
+
+#ifndef CLI_NOHEAP
+/*
+ * An allocator for cli_parse_ex().
+ *
+ * All functions receive `ctx` as the first argument. `realloc` and `free` also
+ * receive a size of the memory previously allocated for `ptr`.
+ */
+typedef struct CliAllocator {
+    void* ctx;
+    void* (*alloc)(void* ctx, size_t size);
+    void* (*realloc)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+    void (*free)(void* ctx, void* ptr, size_t size);
+} CliAllocator;
+
+// A bump allocator over a fixed buffer (see cli_arena_allocator()).
+typedef struct CliArena {
+    char* data;
+    size_t size;
+    size_t used;
+} CliArena;
+#endif // CLI_NOHEAP
+
+// A line of help text of CLI_SCHEMA_HELP() (see cli_write_help()).
+typedef struct CliHelpLine {
+    const char* text;
+    size_t length;
+} CliHelpLine;
+
+#ifdef CLI_WRITER
+// A buffer for messages of printing macros that is written to `fd` at once.
+typedef struct CliWriter {
+    int fd;
+    char* buffer;
+    size_t size;
+    size_t length;
+} CliWriter;
+#endif // CLI_WRITER
+
+// A level of a message of printing macros.
+enum CliLevel {
+    CliLevelDebug,
+    CliLevelInfo,
+    CliLevelError,
+    // Not a level of messages: cli_set_log_level(CliLevelNone) hides all of them.
+    CliLevelNone
+};
+
+/*
+ * Escape sequences and pre-rendered parts of messages for an output stream
+ * (see cli_set_style()).
+ *
+ * Styles are never modified, so they can be read from any thread. Printing
+ * macros load a pointer to the style once per message.
+ */
+typedef struct CliStyle {
+    const char* reset;
+    const char* bold;
+    const char* dim;
+    const char* fore_red;
+    const char* fore_brblue;
+    // Parts of messages around a title, indexed by `enum CliLevel`. For example,
+    // an error is printed as `prefix[CliLevelError]` + title +
+    // `title_end[CliLevelError]` + message.
+    const char* prefix[3];
+    const char* title_end[3];
+    unsigned char prefix_length[3];
+    unsigned char title_end_length[3];
+} CliStyle;
+
+// Styles without and with ANSI escape sequences.
+extern const CliStyle CLI_STYLE_PLAIN;
+extern const CliStyle CLI_STYLE_ANSI;
+
+#ifdef CLI_STATS
+// Costs of a command line, counted since cli_parse() (or another parsing function).
+typedef struct CliStats {
+    // Calls of the allocator of `Cli` (for the block, layers, chunks and others).
+    size_t allocations;
+    size_t reallocations;
+    // Bytes that are allocated for `Cli` now and the maximum of them.
+    size_t bytes;
+    size_t peak_bytes;
+    // Time of the last successful parse in nanoseconds (0 if parsing failed).
+    unsigned long long parse_ns;
+} CliStats;
+#endif // CLI_STATS
+
 typedef struct Cli {
     const char* execfile;
     struct CliArray args;
     struct CliArray cmd_options;
     struct CliArray program_options;
+#ifndef CLI_NOHEAP
+    // The block shared by arrays (NULL if not allocated) and its size. The
+    // block is kept by cli_reset() and cli_reparse().
+    CliAllocator allocator;
+    void* block;
+    size_t block_size;
+#else
+    // A next unused item of the stack (see cli_parse_noheap()).
+    const char** next_unused;
+#endif
+#ifdef CLI_INDEX
+    // An open-addressing hash table over `program_options` and `cmd_options`.
+    //
+    // Each slot is either 0 or an offset of an option in the block shared by
+    // arrays plus one (see `CliArray.options`). The size of the table is
+    // `index_mask + 1`.
+    unsigned int* index;
+    unsigned int index_mask;
+#endif
+#ifdef CLI_RESPONSE_FILES
+    // A list of response files mapped to memory. Arguments from these files
+    // point to the mappings until cli_free() is called.
+    struct CliMapping* mappings;
+#endif
+#ifdef CLI_STREAM
+    // Chunks of arguments read by cli_read_args(). Arguments point to them until
+    // cli_free() is called.
+    struct CliChunk* chunks;
+#endif
+#ifdef CLI_LAYERS
+    // Options that are loaded from other sources (e.g. by cli_load_env() or cli_load_config()),
+    // from the lowest precedence. They are indexed after `cmd_options`.
+    struct CliLayer* layers;
+#endif
+#ifdef CLI_SHORT_FLAGS
+    // A bit for every character of program options with one dash (see
+    // cli_flag()).
+    unsigned long long short_flags[4];
+#endif
+#ifdef CLI_STATS
+    CliStats stats;
+#endif
 } Cli;
 
 enum CliError {
@@ -156,16 +466,119 @@ enum CliError {
     CliErrorFatal
 };
 
+enum CliTokenKind {
+    CliTokenProgramOption,
+    CliTokenArg,
+    CliTokenCmdOption
+};
+
+// An argument classified by cli_parser_next().
+struct CliToken {
+    enum CliTokenKind kind;
+    const char* arg;
+};
+
+// A streaming parser that classifies arguments one by one without storing them.
+typedef struct CliParser {
+    const char* execfile;
+    // Arguments that are not classified yet.
+    int argc;
+    char** argv;
+    bool is_cmd_option;
+    bool has_cmd_options;
+    // The last positional argument or NULL.
+    const char* last_arg;
+    enum CliError error;
+    // If true, errors are not printed (only `error` is set).
+    bool is_quiet;
+} CliParser;
+
 /* Initialize variables for formatting output.
  *
  * If `CLI_RESET` contains an empty string, all variables are initalized with
  * escape sequences, according to their names.
  * Otherwise, variables are initalized with empty strings.
  *
+ * The default style of output streams is switched between `CLI_STYLE_PLAIN`
+ * and `CLI_STYLE_ANSI` atomically, but the variables are not: threads should
+ * read escape sequences from cli_get_style() instead.
+ *
  * If `CLI_NO_STYLES` is defined, does nothing.
  */
 void cli_toggle_styles(void);
 
+/*
+ * Print only messages of `level` and higher levels (e.g. CliLevelInfo hides
+ * debug messages). Disabled calls do not evaluate their arguments.
+ *
+ * The level is read with a relaxed atomic load, so it can be changed while
+ * other threads print. Messages below CLI_LOG_LEVEL are never printed.
+ */
+void cli_set_log_level(enum CliLevel level);
+
+/* Returns the level set by cli_set_log_level() (CLI_LOG_LEVEL by default). */
+enum CliLevel cli_get_log_level(void);
+
+/*
+ * Returns the style bound to `fd` with cli_set_style() or cli_detect_style().
+ * If no style is bound, returns the default style (see cli_toggle_styles()).
+ *
+ * Never blocks and can be called from any thread.
+ */
+const CliStyle* cli_get_style(int fd);
+
+/*
+ * Bind `style` to `fd` (stdin, stdout or stderr). If `style` is NULL, `fd` uses
+ * the default style again. Styles cannot be bound to other file descriptors.
+ *
+ * Printing macros use the style of stderr (or of the fd of the current
+ * `CliWriter`).
+ */
+void cli_set_style(int fd, const CliStyle* style);
+
+/*
+ * Bind `CLI_STYLE_ANSI` to `fd` if it is a terminal and `NO_COLOR` is not set
+ * (or is empty), otherwise bind `CLI_STYLE_PLAIN`. Returns the bound style.
+ *
+ * The detection is done once: if a style is already bound to `fd`, it is
+ * returned instead. If `CLI_NO_STYLES` is defined, always binds
+ * `CLI_STYLE_PLAIN`.
+ */
+const CliStyle* cli_detect_style(int fd);
+
+/* Prepare `parser` for the command line. `argv[0]` is saved to `parser->execfile`. */
+void cli_parser_init(CliParser* parser, int argc, char** argv);
+
+/*
+ * Classify a next argument of the command line and save it to `token`.
+ *
+ * Returns false if no arguments are left or an argument violates rules of
+ * cli_parse(). In the latter case, an error is printed and `parser->error` is
+ * set. Double dashes are not returned as tokens.
+ *
+ * For example:
+ *     CliParser parser;
+ *     struct CliToken token;
+ *
+ *     cli_parser_init(&parser, argc, argv);
+ *     while (cli_parser_next(&parser, &token)) {
+ *         // ...
+ *     }
+ *     if (parser.error) {
+ *         return parser.error;
+ *     }
+ */
+bool cli_parser_next(CliParser* parser, struct CliToken* token);
+
+/*
+ * Classify `arg` as a next argument of the command line and save it to
+ * `token`.
+ *
+ * Same as cli_parser_next(), but `arg` can come from anywhere (e.g. from a
+ * file). Returns false if `arg` is a double dash or an error occurs.
+ */
+bool cli_parser_feed(CliParser* parser, const char* arg, struct CliToken* token);
+
 /*
  * Parse the command line and save results to `cli`.
  *
@@ -174,6 +587,129 @@ void cli_toggle_styles(void);
  */
 enum CliError cli_parse(int argc, char** argv, Cli* cli);
 
+#ifndef CLI_NOHEAP
+/*
+ * Same as cli_parse(), but allocate memory with `allocator`. The allocator is
+ * saved to `cli` and used by cli_free().
+ *
+ * If `allocator` is NULL, CLI_MALLOC, CLI_REALLOC and CLI_FREE are used.
+ */
+enum CliError cli_parse_ex(int argc, char** argv, Cli* cli, const CliAllocator* allocator);
+
+/*
+ * Same as cli_parse(), but reuse the block of `cli` from a previous call of
+ * cli_parse(), cli_parse_ex() or cli_reparse() (or a zero-initialized `cli`
+ * that uses the default allocator).
+ *
+ * The block is only replaced if a command line does not fit, so parsing many
+ * command lines makes no allocations once the block is large enough. If
+ * parsing fails, results are reset, but the block is kept. cli_free() releases
+ * the block.
+ */
+enum CliError cli_reparse(int argc, char** argv, Cli* cli);
+
+/*
+ * Forget results of a previous parse (e.g. unmap response files), but keep the
+ * block for cli_reparse().
+ */
+void cli_reset(Cli* cli);
+
+/*
+ * Split `line` into arguments like a shell and parse them like cli_parse().
+ * Unlike `argv`, `line` has no executable file, so `cli->execfile` is NULL.
+ *
+ * Arguments are separated by whitespace and may be quoted ('' and "") or
+ * escaped (\). `line` is rewritten in place: arguments are unquoted and
+ * terminated with '\0', so they point to `line` and are not copied. `line` is
+ * tokenized before parsing, so the block is sized exactly by the number of
+ * arguments. `@path` arguments are not expanded.
+ */
+enum CliError cli_parse_string(char* line, Cli* cli);
+
+#ifdef CLI_STREAM
+/*
+ * Read NUL-delimited arguments from `fd` until the end of file and append them
+ * to `cli->args` (e.g. for `find -print0 | program -0`). A last argument may
+ * have no '\0'. `cli` should be parsed before.
+ *
+ * The file is read into one reused buffer of CLI_STREAM_BUFFER_SIZE bytes, and
+ * arguments are copied to large chunks that belong to `cli` until cli_free() is
+ * called. The block of `cli` is replaced once after all arguments are read.
+ *
+ * Returns `CliErrorUser` if an argument is longer than the buffer, or
+ * `CliErrorFatal` if `fd` cannot be read or memory cannot be allocated. On
+ * errors, `cli` is not changed.
+ */
+enum CliError cli_read_args(Cli* cli, int fd);
+
+/*
+ * Read NUL-delimited arguments from `fd` into `buffer` of `size` bytes and call
+ * `callback` for each argument as soon as it is read. Arguments are terminated
+ * with '\0' and valid only until `callback` returns, so memory is bounded by
+ * `size` for any number of arguments:
+ *     static bool process(void* ctx, const char* arg, size_t length) {
+ *         // ...
+ *         return true;
+ *     }
+ *
+ *     char buffer[64 * 1024];
+ *     enum CliError error = cli_stream_args(0, buffer, sizeof(buffer), process, NULL);
+ *
+ * Returns `CliErrorUser` if an argument does not fit into `buffer` (with its
+ * '\0') or `callback` returns false, or `CliErrorFatal` if `fd` cannot be read.
+ */
+enum CliError cli_stream_args(
+    int fd, char* buffer, size_t size, bool (*callback)(void* ctx, const char* arg, size_t length),
+    void* ctx
+);
+#endif // CLI_STREAM
+
+#ifdef CLI_BATCH
+// Memory of results of cli_parse_batch() (see cli_free_batch()).
+typedef struct CliBatch {
+    struct CliSlab* slabs;
+} CliBatch;
+
+/*
+ * Parse `count` command lines with cli_parse_string() on `threads` threads (or
+ * on all online CPUs if `threads` is 0) and save results to `results`.
+ *
+ * Errors are not printed: an error of `lines[i]` is saved to `errors[i]` (if
+ * `errors` is not NULL), and `results[i]` is empty. Returns `CliErrorOk` if all
+ * lines are parsed, `CliErrorFatal` if memory cannot be allocated for some
+ * lines, or `CliErrorUser` otherwise.
+ *
+ * Threads take lines in small chunks until no lines are left, and every thread
+ * allocates blocks from its own arena. Blocks of results belong to `batch`
+ * until cli_free_batch() is called, so cli_free() is not needed for results.
+ */
+enum CliError cli_parse_batch(
+    CliBatch* batch, char** lines, size_t count, Cli* results, enum CliError* errors,
+    unsigned int threads
+);
+
+/* Release memory of all results of cli_parse_batch(). */
+void cli_free_batch(CliBatch* batch);
+#endif // CLI_BATCH
+
+/* Returns an allocator that uses CLI_MALLOC, CLI_REALLOC and CLI_FREE. */
+CliAllocator cli_default_allocator(void);
+
+/* Prepare `arena` to allocate memory from `buffer` of `size` bytes. */
+void cli_arena_init(CliArena* arena, void* buffer, size_t size);
+
+/*
+ * Returns an allocator that allocates memory from `arena`.
+ *
+ * Memory is never freed individually, so cli_free() does not release anything
+ * and cli_arena_reset() releases everything at once.
+ */
+CliAllocator cli_arena_allocator(CliArena* arena);
+
+/* Release all memory allocated from `arena`. */
+void cli_arena_reset(CliArena* arena);
+#endif // CLI_NOHEAP
+
 #ifdef CLI_NOHEAP
 /*
  * Parse the command line and save pointers to `stack` elements to `cli`.
@@ -184,132 +720,840 @@ enum CliError cli_parse(int argc, char** argv, Cli* cli);
 enum CliError cli_parse_noheap(int argc, char** argv, struct Cli* cli, const char** stack);
 #endif
 
-/* Free memory occupied by dynamic arrays.
+// A subcommand for cli_dispatch(), e.g. `add` in `./program add file`.
+typedef struct CliCommand {
+    const char* name;
+    // Receives the whole command line (`cli`) and the part of the subcommand
+    // (`command`, see cli_dispatch()). The result is returned by cli_dispatch().
+    int (*run)(Cli* cli, Cli* command, void* ctx);
+    const char* help;
+} CliCommand;
+
+/*
+ * Find a command named `name` in `commands` sorted by name (like strcmp()). If
+ * there is no such command, the only command that starts with `name` is
+ * returned (e.g. `st` for `status`).
  *
- * If either `CLI_NOHEAP` or `CLI_NOHEAP_IMPLEMENTATION` is defined, does
- * nothing.
+ * Returns NULL if no command (or several commands) match. In both cases, the
+ * number of matching commands is saved to `matches` (if it is not NULL).
  */
-void cli_free(Cli* cli);
+const CliCommand*
+cli_find_command(const CliCommand* commands, size_t count, const char* name, size_t* matches);
 
-/********************************** =(^-x-^)= **********************************/
+/*
+ * Run a command named by the first positional argument (see cli_find_command()).
+ *
+ * The command receives its own `Cli`: `execfile` is the name of the command,
+ * `args` are positional arguments after it, `program_options` are command
+ * options of `cli` and `cmd_options` are empty. With CLI_INDEX, the command
+ * gets a separate small index over these options.
+ *
+ * Returns the result of the command. If the command is not specified, unknown
+ * or ambiguous, prints an error and returns `CliErrorUser`.
+ */
+int cli_dispatch(Cli* cli, const CliCommand* commands, size_t count, void* ctx);
 
-#ifdef CLI_IMPLEMENTATION
+// A change of program options for cli_build_argv().
+typedef struct CliEdit {
+    // Options named `name` (with dashes, e.g. "--threads") are removed. Can be NULL.
+    const char* name;
+    // An argument added after other program options (e.g. "--threads=4"), or NULL.
+    const char* arg;
+} CliEdit;
 
-#define CLI_STR_(x) #x
-#define CLI_STR(x)  CLI_STR_(x)
+/*
+ * Returns how many pointers (with the NULL) cli_build_argv() needs at most for
+ * `cli` and `edit_count` edits.
+ */
+size_t cli_argv_capacity(const Cli* cli, size_t edit_count);
 
-// Cannot be equal to 0. Otherwise, memory checks will be failed.
-#define CLI_INVALID_PTR (const char**)0xCA10CAFE
+/*
+ * Build a NULL-terminated `argv` of `capacity` pointers that cli_parse() splits
+ * into the same arrays as `cli`, except that program options are changed by
+ * `edits`. An edit removes options by name, adds an argument, or both (to
+ * override an option):
+ *     CliEdit edits[] = {
+ *         { "--threads", "--threads=4" }, // override
+ *         { "--daemon", NULL },           // remove
+ *         { NULL, "--worker" },           // insert
+ *     };
+ *
+ * Strings are not copied: the result points to `cli->execfile` and arguments of
+ * `cli` (and `edits`), so they should stay valid until the process is spawned.
+ * No memory is allocated and no locks are taken, so `argv` can be built after
+ * vfork() or passed to posix_spawn() and execv() directly.
+ *
+ * Returns the number of arguments before the NULL, or 0 if `capacity` is less
+ * than cli_argv_capacity() or a positional argument starts with '-' (e.g. a
+ * file name from cli_read_args()): cli_parse() classifies every such argument
+ * as an option, even after a double dash, so it cannot be passed through argv.
+ */
+size_t cli_build_argv(
+    const Cli* cli, const CliEdit* edits, size_t edit_count, char** argv, size_t capacity
+);
 
-#ifdef CLI_NO_STDBOOL_H
-typedef unsigned char bool
-#define true  (bool)1
-#define false (bool)0
-#else
-#include <stdbool.h>
-#endif // CLI_NO_STDBOOL_H
+#ifdef CLI_INDEX
+/*
+ * Find a program option by its `name` (a part before '=', including dashes).
+ *
+ * Returns a pointer to a value after '=', an empty string if the option has no
+ * value, or NULL if the option is not specified.
+ * If the option is specified several times, the last one is used.
+ */
+const char* cli_get_option(const Cli* cli, const char* name);
 
-#ifndef CLI_NO_STDIO_H
-#include <stdio.h>
-#endif
+/* Check whether a program option `name` is specified. */
+bool cli_has_flag(const Cli* cli, const char* name);
 
-#ifndef CLI_NOHEAP
-#if !defined CLI_MALLOC || !defined CLI_REALLOC || !defined CLI_FREE
-#include <stdlib.h>
-#endif // !CLI_MALLOC || !CLI_REALLOC || !CLI_FREE
-#endif
+/* Same as cli_get_option(), but for command options. */
+const char* cli_get_cmd_option(const Cli* cli, const char* name);
 
-#ifndef CLI_MALLOC
-#define CLI_MALLOC malloc
-#endif
+/* Same as cli_has_flag(), but for command options. */
+bool cli_has_cmd_flag(const Cli* cli, const char* name);
 
-#ifndef CLI_REALLOC
-#define CLI_REALLOC realloc
-#endif
+/*
+ * Convert a value of a program option `name` and save it to `value`. If the
+ * option is not specified, `value` is not changed, so it can hold a default:
+ *     long long threads = 4;
+ *     if (cli_get_int(&cli, "--threads", &threads)) {
+ *         return CliErrorUser;
+ *     }
+ *
+ * Values are parsed without the locale: integers are decimal and sizes can have
+ * a binary suffix (`k`, `M`, `G` or `T`, e.g. `64M`). Booleans are `1`, `true`,
+ * `yes`, `on` or `0`, `false`, `no`, `off` in any case, and an option without a
+ * value is true.
+ *
+ * A converted value is cached in the option, so a next call does not parse it
+ * again. If the value is invalid, prints an error and returns `CliErrorUser`.
+ */
+enum CliError cli_get_int(Cli* cli, const char* name, long long* value);
+enum CliError cli_get_u64(Cli* cli, const char* name, unsigned long long* value);
+enum CliError cli_get_double(Cli* cli, const char* name, double* value);
+enum CliError cli_get_bool(Cli* cli, const char* name, bool* value);
+enum CliError cli_get_size(Cli* cli, const char* name, size_t* value);
 
-#ifndef CLI_FREE
-#define CLI_FREE free
+#ifdef CLI_ENV
+/*
+ * Add environment variables that start with `prefix` to the index as program
+ * options with lower precedence than the command line. For example, with the
+ * prefix "APP_", `APP_DRY_RUN=1` is found as `--dry-run=1` by cli_get_option()
+ * and typed accessors, unless `--dry-run` is specified.
+ *
+ * Lookups do not scan `environ` again, and values are not copied: they point
+ * to the environment until cli_free(), so it should not be changed meanwhile.
+ * The variables are not added to `program_options`.
+ *
+ * Returns `CliErrorFatal` if memory cannot be allocated.
+ */
+enum CliError cli_load_env(Cli* cli, const char* prefix);
 #endif
 
-#ifndef CLI_ASSERT
-#include <assert.h>
-#define CLI_ASSERT assert
+#ifdef CLI_CONFIG
+/*
+ * Add options of a config file `path` to the index as program options with
+ * lower precedence than the command line and cli_load_env(). Options of files
+ * loaded later replace options of files loaded before.
+ *
+ * Every line is `key=value` or `key` (a flag), and `key` is found as `--key`
+ * (unless it starts with dashes itself). Whitespace around keys and values is
+ * skipped, and values are not unquoted. Blank lines and lines that start with
+ * '#' are ignored:
+ *     # app.conf
+ *     threads = 8
+ *     dry-run
+ *
+ * The file is mapped to memory privately and tokenized in place, so options
+ * point to the mapping until cli_free() and are not copied. The options are not
+ * added to `program_options`.
+ *
+ * Returns `CliErrorUser` if the file cannot be opened or a line has no key, or
+ * `CliErrorFatal` if memory cannot be allocated.
+ */
+enum CliError cli_load_config(Cli* cli, const char* path);
 #endif
+#endif // CLI_INDEX
 
-#ifndef CLI_DEFAULT_ARR_CAP
-#define CLI_DEFAULT_ARR_CAP 5
-#endif
+#ifdef CLI_SHORT_FLAGS
+/*
+ * Check whether a short program option `flag` is specified, alone (`-v`) or in
+ * a cluster (`-xvf`). If a cluster has a value, its characters before '=' are
+ * checked (`-j=4` specifies `j`).
+ *
+ * Clusters stay single items of `program_options`: cli_parse() only sets a bit
+ * for every character, so this is a single bit test.
+ */
+static inline bool cli_flag(const Cli* cli, char flag) {
+    unsigned char bit = (unsigned char)flag;
+    return (cli->short_flags[bit >> 6] >> (bit & 63)) & 1;
+}
+#endif // CLI_SHORT_FLAGS
 
-#ifndef CLI_ERROR_SYM
-#define CLI_ERROR_SYM "✖"
-#endif
+#ifdef CLI_VIEWS
+enum CliSchemaError {
+    CliSchemaErrorUnknown,
+    CliSchemaErrorValue,
+    CliSchemaErrorNoValue
+};
 
-#ifndef CLI_INFO_SYM
-#define CLI_INFO_SYM "●"
-#endif
+/*
+ * Print an error about `option` that does not match a schema and free `cli`.
+ *
+ * This function is used by CLI_SCHEMA() and returns `CliErrorUser`.
+ */
+enum CliError cli_schema_error(Cli* cli, const char* option, enum CliSchemaError error);
 
-#ifndef cli_print_error
-#define cli_print_error(title, msg)                                                        \
-    fprintf(                                                                               \
-        stderr, "%s" CLI_ERROR_SYM "%s%s " title "%s: " msg "\n", CLI_FORE_RED, CLI_RESET, \
-        CLI_BOLD, CLI_RESET                                                                \
-    )
-#endif
+/*
+ * Declare a struct `name` for options listed by `list` and a function that
+ * fills it:
+ *     enum CliError name##_parse(int argc, char** argv, Cli* cli, name* result);
+ *
+ * `list` is an X-macro that lists options as
+ * `X(field, short_name, long_name, kind, help)`, where
+ * - `field` is a name of the field in `name`;
+ * - `short_name` and `long_name` are string literals, e.g. "-v" and
+ *   "--verbose". Use "" if the option has no such name;
+ * - `kind` is either CLI_FLAG (a `bool` field, the option cannot have a value)
+ *   or CLI_VALUE (a `const char*` field, the option requires a value);
+ * - `help` is a string literal with a description of the option.
+ *
+ * For example:
+ *     #define APP_OPTIONS(X)                                             \
+ *         X(verbose, "-v", "--verbose", CLI_FLAG, "Print more messages") \
+ *         X(threads, "-j", "--threads", CLI_VALUE, "Number of threads")
+ *
+ *     CLI_SCHEMA(AppOptions, APP_OPTIONS)
+ *
+ * Program options are matched right after cli_parse() by comparing lengths and
+ * names known at compile time. Fields of missing options are zeroed.
+ * If a program option is not listed or has a wrong kind, an error is printed,
+ * `cli` is freed and `CliErrorUser` is returned.
+ */
+#define CLI_SCHEMA(name, list)                                                 \
+    typedef struct name {                                                      \
+        list(CLI_SCHEMA_FIELD_)                                                \
+    } name;                                                                    \
+                                                                               \
+    static inline enum CliError name##_parse(                                  \
+        int argc, char** argv, Cli* cli, name* result                          \
+    ) {                                                                        \
+        enum CliError error = cli_parse(argc, argv, cli);                      \
+        if (error) {                                                           \
+            return error;                                                      \
+        }                                                                      \
+        memset(result, 0, sizeof(*result));                                    \
+                                                                               \
+        for (size_t i = 0; i < cli->program_options.length; i++) {             \
+            const struct CliOption* option = &cli->program_options.options[i]; \
+            list(CLI_SCHEMA_MATCH_)                                            \
+            return cli_schema_error(                                           \
+                cli, cli_at(cli->program_options, i), CliSchemaErrorUnknown    \
+            );                                                                 \
+        }                                                                      \
+        return CliErrorOk;                                                     \
+    }
 
-#ifndef cli_printf_error
-#define cli_printf_error(title, msg, ...)                                                  \
-    fprintf(                                                                               \
-        stderr, "%s" CLI_ERROR_SYM "%s%s " title "%s: " msg "\n", CLI_FORE_RED, CLI_RESET, \
-        CLI_BOLD, CLI_RESET, __VA_ARGS__                                                   \
-    )
-#endif
+#define CLI_SCHEMA_FIELD_(field, short_name, long_name, kind, help) CLI_SCHEMA_FIELD_##kind(field)
+#define CLI_SCHEMA_FIELD_CLI_FLAG(field)                            bool field;
+#define CLI_SCHEMA_FIELD_CLI_VALUE(field)                           const char* field;
 
-#ifndef cli_print_info
-#define cli_print_info(title, msg)                                                           \
-    fprintf(                                                                                 \
-        stderr, "%s" CLI_INFO_SYM "%s%s " title "%s: " msg "\n", CLI_FORE_BRBLUE, CLI_RESET, \
-        CLI_BOLD, CLI_RESET                                                                  \
-    )
-#endif
+#define CLI_SCHEMA_MATCH_(field, short_name, long_name, kind, help)                \
+    if (CLI_SCHEMA_IS_(option, short_name) || CLI_SCHEMA_IS_(option, long_name)) { \
+        if (!CLI_SCHEMA_SET_##kind(result->field, option)) {                       \
+            return cli_schema_error(                                               \
+                cli, cli_at(cli->program_options, i), CLI_SCHEMA_ERROR_##kind      \
+            );                                                                     \
+        }                                                                          \
+        continue;                                                                  \
+    }
 
-#ifndef cli_printf_info
-#define cli_printf_info(title, msg, ...)                                                     \
-    fprintf(                                                                                 \
-        stderr, "%s" CLI_INFO_SYM "%s%s " title "%s: " msg "\n", CLI_FORE_BRBLUE, CLI_RESET, \
-        CLI_BOLD, CLI_RESET, __VA_ARGS__                                                     \
-    )
-#endif
+#define CLI_SCHEMA_SET_CLI_FLAG(field, option)  ((field) = true, (option)->value == NULL)
+#define CLI_SCHEMA_SET_CLI_VALUE(field, option) ((field) = (option)->value, (option)->value != NULL)
+#define CLI_SCHEMA_ERROR_CLI_FLAG               CliSchemaErrorValue
+#define CLI_SCHEMA_ERROR_CLI_VALUE              CliSchemaErrorNoValue
 
-#ifndef cli_printf_debug
-#define cli_printf_debug(msg, ...)                                                                 \
-    fprintf(                                                                                       \
-        stderr, "%s" __FILE__ ":" CLI_STR(__LINE__) ":%s%sDebug%s: " msg "\n", CLI_DIM, CLI_RESET, \
-        CLI_BOLD, CLI_RESET, __VA_ARGS__                                                           \
-    )
-#endif
+// Dashes and a length of `literal` are known at compile time. Thus, most options are rejected by
+// comparing integers, and names are compared with memcmp() of a constant size.
+#define CLI_SCHEMA_DASHES_(literal) (sizeof(literal) > 2 && (literal)[1] == '-' ? 2 : 1)
+#define CLI_SCHEMA_IS_(option, literal)                                                                \
+    (sizeof(literal) > 1 && (option)->name_length == sizeof(literal) - 1 - CLI_SCHEMA_DASHES_(literal) \
+     && (option)->dashes == CLI_SCHEMA_DASHES_(literal)                                                \
+     && memcmp((option)->name, (literal) + CLI_SCHEMA_DASHES_(literal),                                \
+               sizeof(literal) - 1 - CLI_SCHEMA_DASHES_(literal))                                      \
+            == 0)
+#endif // CLI_VIEWS
 
-    void
-    cli_toggle_styles(void) {
-#ifndef CLI_NO_STYLES
-    if (CLI_RESET[0]) {
-        CLI_RESET = "";
-        CLI_BOLD = "";
-        CLI_DIM = "";
-        CLI_FORE_RED = "";
-        CLI_FORE_BRBLUE = "";
-    } else {
-        CLI_RESET = "\033[0m";
-        CLI_BOLD = "\033[1m";
-        CLI_DIM = "\033[2m";
-        CLI_FORE_RED = "\033[31m";
-        CLI_FORE_BRBLUE = "\033[94m";
-    }
+/*
+ * Write `count` lines of help text to stdout with a single writev(2) (one per
+ * 64 lines). `styled` is used if stdout has styles (see cli_get_style()),
+ * otherwise `plain` is used.
+ *
+ * Returns the number of written bytes or -1. It is used by CLI_SCHEMA_HELP().
+ */
+int cli_write_help(const CliHelpLine* styled, const CliHelpLine* plain, size_t count);
+
+/*
+ * Declare help text for options listed by `list` (see CLI_SCHEMA()) and a
+ * function that prints it:
+ *     int name##_print_help(void);
+ *
+ * The text is `usage` followed by names of every option and its `help` on the
+ * next line. Every line is concatenated from string literals at compile time,
+ * both with escape sequences of styles and without them, so printing it is a
+ * single writev(2) with no formatting (see cli_write_help()).
+ *
+ * For example:
+ *     CLI_SCHEMA_HELP(AppOptions, "Usage: app [OPTIONS] FILES", APP_OPTIONS)
+ *
+ *     if (argc == 1) {
+ *         AppOptions_print_help();
+ *     }
+ */
+#define CLI_SCHEMA_HELP(name, usage, list)                                               \
+    static const CliHelpLine name##_help_styled[] = {                                    \
+        CLI_SCHEMA_HELP_USAGE_(CLI_BOLD_SEQ usage CLI_RESET_SEQ) list(                   \
+            CLI_SCHEMA_HELP_STYLED_                                                      \
+        )                                                                                \
+    };                                                                                   \
+    static const CliHelpLine name##_help_plain[] = {                                     \
+        CLI_SCHEMA_HELP_USAGE_(usage) list(CLI_SCHEMA_HELP_PLAIN_)                       \
+    };                                                                                   \
+                                                                                         \
+    static inline int name##_print_help(void) {                                          \
+        return cli_write_help(                                                           \
+            name##_help_styled, name##_help_plain,                                       \
+            sizeof(name##_help_plain) / sizeof(CliHelpLine)                              \
+        );                                                                               \
+    }
+
+#define CLI_SCHEMA_HELP_USAGE_(usage) { usage "\n\nOptions:\n", sizeof(usage "\n\nOptions:\n") - 1 },
+
+#define CLI_SCHEMA_HELP_STYLED_(field, short_name, long_name, kind, help)           \
+    CLI_SCHEMA_HELP_LINE_(                                                          \
+        CLI_BOLD_SEQ, CLI_DIM_SEQ, CLI_RESET_SEQ, short_name, long_name, kind, help \
+    )
+#define CLI_SCHEMA_HELP_PLAIN_(field, short_name, long_name, kind, help) \
+    CLI_SCHEMA_HELP_LINE_("", "", "", short_name, long_name, kind, help)
+
+// For example, "  -j --threads=VALUE\n      Number of threads\n". Names are separated only if both
+// of them are not empty, which is known at compile time from their sizes.
+#define CLI_SCHEMA_HELP_LINE_(bold, dim, reset, short_name, long_name, kind, help)             \
+    CLI_SCHEMA_HELP_TEXT_(                                                                     \
+        sizeof(short_name) > 1 && sizeof(long_name) > 1,                                       \
+        "  " bold short_name " " long_name reset CLI_SCHEMA_HELP_##kind(dim, reset) "\n"       \
+        "      " help "\n",                                                                    \
+        "  " bold short_name long_name reset CLI_SCHEMA_HELP_##kind(dim, reset) "\n"           \
+        "      " help "\n"                                                                     \
+    )
+#define CLI_SCHEMA_HELP_CLI_FLAG(dim, reset)  ""
+#define CLI_SCHEMA_HELP_CLI_VALUE(dim, reset) "=" dim "VALUE" reset
+
+// A line `text` if `condition` is true, otherwise `other_text`.
+#define CLI_SCHEMA_HELP_TEXT_(condition, text, other_text) \
+    { (condition) ? (text) : (other_text), (condition) ? sizeof(text) - 1 : sizeof(other_text) - 1 },
+
+#ifdef CLI_WRITER
+/* Prepare `writer` to buffer messages in `buffer` of `size` bytes for `fd`. */
+void cli_writer_init(CliWriter* writer, int fd, char* buffer, size_t size);
+
+/*
+ * Route printing macros (e.g. cli_print_error()) to `writer`. If `writer` is
+ * NULL, messages are printed to stderr directly.
+ *
+ * A previous writer is flushed. The current writer is also flushed at exit.
+ */
+void cli_set_writer(CliWriter* writer);
+
+/*
+ * Format a message into `writer` with a single vsnprintf().
+ *
+ * If the message does not fit, `writer` is flushed first. Messages larger than
+ * the whole buffer are formatted on the heap and written directly.
+ */
+int cli_writer_printf(CliWriter* writer, const char* format, ...);
+
+/* Write buffered messages with a single write(2) (if possible). */
+bool cli_writer_flush(CliWriter* writer);
+#endif // CLI_WRITER
+
+#ifdef CLI_LOG_RING
+/*
+ * Write messages of the log ring to stderr with as few write(2) calls as
+ * possible and returns the number of written messages.
+ *
+ * Only one thread drains the ring at a time: if another thread is flushing,
+ * returns 0 immediately. Printing threads never wait for a flush. The ring is
+ * also flushed at exit.
+ */
+size_t cli_log_flush(void);
+
+/* Returns the number of messages that were dropped because the ring was full. */
+size_t cli_log_dropped(void);
+#endif // CLI_LOG_RING
+
+#ifdef CLI_STATS
+/*
+ * Print `cli->stats` and lengths of arrays with an information message (see
+ * cli_set_log_level()), e.g. to compare costs of configurations:
+ *     ● CLI stats: 1 allocations, 0 reallocations, 1536 bytes (1536 at peak), 5384 ns, 3 program
+ *     options, 2 args, 1 cmd options.
+ *
+ * Arrays are never reallocated by cli_parse(), so reallocations only come from
+ * other functions (e.g. cli_read_args()).
+ */
+void cli_stats_dump(const Cli* cli);
+#endif
+
+/* Free memory occupied by dynamic arrays.
+ *
+ * If either `CLI_NOHEAP` or `CLI_NOHEAP_IMPLEMENTATION` is defined, does
+ * nothing.
+ */
+void cli_free(Cli* cli);
+
+/********************************** =(^-x-^)= **********************************/
+
+#ifdef CLI_IMPLEMENTATION
+
+#define CLI_STR_(x) #x
+#define CLI_STR(x)  CLI_STR_(x)
+
+// Cannot be equal to 0. Otherwise, memory checks will be failed.
+#define CLI_INVALID_PTR (const char**)0xCA10CAFE
+
+#ifndef CLI_NO_STDIO_H
+#include <stdio.h>
+#endif
+
+#if defined(CLI_SIMD) && defined(CLI_VIEWS) && defined(__GNUC__)
+#include <stdint.h>
+
+// SIMD loads may read bytes around a string (see cli_find_name_end()).
+#define CLI_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define CLI_SIMD_WIDTH     32
+#define CLI_SIMD_MASK_BITS 1
+typedef unsigned int cli_simd_mask_t;
+#define cli_simd_ctz __builtin_ctz
+
+// Returns a mask with a bit set for every '=' or '\0' byte of an aligned `chunk`.
+CLI_NO_SANITIZE_ADDRESS static inline cli_simd_mask_t cli_simd_find_name_end(const char* chunk) {
+    __m256i bytes = _mm256_load_si256((const __m256i*)chunk);
+    __m256i found = _mm256_or_si256(
+        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('=')),
+        _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256())
+    );
+    return (cli_simd_mask_t)_mm256_movemask_epi8(found);
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define CLI_SIMD_WIDTH     16
+#define CLI_SIMD_MASK_BITS 1
+typedef unsigned int cli_simd_mask_t;
+#define cli_simd_ctz __builtin_ctz
+
+CLI_NO_SANITIZE_ADDRESS static inline cli_simd_mask_t cli_simd_find_name_end(const char* chunk) {
+    __m128i bytes = _mm_load_si128((const __m128i*)chunk);
+    __m128i found = _mm_or_si128(
+        _mm_cmpeq_epi8(bytes, _mm_set1_epi8('=')), _mm_cmpeq_epi8(bytes, _mm_setzero_si128())
+    );
+    return (cli_simd_mask_t)_mm_movemask_epi8(found);
+}
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+// NEON has no movemask, so every byte is narrowed to 4 bits of a 64-bit mask.
+#define CLI_SIMD_WIDTH     16
+#define CLI_SIMD_MASK_BITS 4
+typedef uint64_t cli_simd_mask_t;
+#define cli_simd_ctz __builtin_ctzll
+
+CLI_NO_SANITIZE_ADDRESS static inline cli_simd_mask_t cli_simd_find_name_end(const char* chunk) {
+    uint8x16_t bytes = vld1q_u8((const uint8_t*)chunk);
+    uint8x16_t found = vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('=')), vceqq_u8(bytes, vdupq_n_u8(0)));
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(found), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+#endif
+
+#endif // CLI_SIMD && CLI_VIEWS && __GNUC__
+
+#if defined(CLI_RESPONSE_FILES) || defined(CLI_CONFIG)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Strict ISO C modes (e.g. -std=c11) hide MAP_ANONYMOUS, so cli_map_file() maps /dev/zero instead.
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+#ifdef CLI_STREAM
+#include <errno.h>
+#include <unistd.h>
+
+#ifndef CLI_STREAM_BUFFER_SIZE
+#define CLI_STREAM_BUFFER_SIZE (64 * 1024)
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define CLI_HAS_WRITEV
+#define CLI_HAS_ISATTY
+#endif
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef CLI_INDEX
+#include <float.h>
+#include <limits.h>
+#include <locale.h>
+#endif
+
+#ifdef CLI_BATCH
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifndef CLI_MALLOC
+#define CLI_MALLOC malloc
+#endif
+
+#ifndef CLI_REALLOC
+#define CLI_REALLOC realloc
+#endif
+
+#ifndef CLI_FREE
+#define CLI_FREE free
+#endif
+
+#ifndef CLI_ASSERT
+#include <assert.h>
+#define CLI_ASSERT assert
+#endif
+
+#ifndef CLI_ERROR_SYM
+#define CLI_ERROR_SYM "✖"
+#endif
+
+#ifndef CLI_INFO_SYM
+#define CLI_INFO_SYM "●"
+#endif
+
+#ifdef CLI_LOG_RING
+#ifndef CLI_LOG_RING_SIZE
+#define CLI_LOG_RING_SIZE 1024
+#endif
+
+#ifndef CLI_LOG_RECORD_SIZE
+#define CLI_LOG_RECORD_SIZE 512
+#endif
+#endif // CLI_LOG_RING
+
+#ifdef CLI_WRITER
+// See cli_set_writer().
+static CliWriter* cli_writer = NULL;
+#endif
+
+// Lock-free loads and stores of style pointers. Without GCC builtins, plain
+// accesses are used.
+#ifdef __GNUC__
+#define CLI_ATOMIC_LOAD(ptr)         __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define CLI_ATOMIC_STORE(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+#define CLI_ATOMIC_CAS(ptr, expected, desired)                                                     \
+    __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define CLI_ATOMIC_LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define CLI_ATOMIC_ADD(ptr, value)    __atomic_fetch_add(ptr, value, __ATOMIC_RELAXED)
+#define CLI_UNLIKELY(x)               __builtin_expect(!!(x), 0)
+#else
+#define CLI_ATOMIC_LOAD(ptr)         (*(ptr))
+#define CLI_ATOMIC_STORE(ptr, value) (*(ptr) = (value))
+#define CLI_ATOMIC_CAS(ptr, expected, desired)                                           \
+    (*(ptr) == *(expected) ? (*(ptr) = (desired), true) : (*(expected) = *(ptr), false))
+#define CLI_ATOMIC_LOAD_RELAXED(ptr) (*(ptr))
+#define CLI_ATOMIC_ADD(ptr, value)    ((*(ptr) += (value)) - (value))
+#define CLI_UNLIKELY(x)               (x)
+#endif
+
+// Parts of messages are rendered at compile time, so their lengths are known.
+#define CLI_STYLE_(reset, bold, dim, red, brblue, error, info, debug, debug_title, title_end) \
+    {                                                                                         \
+        reset, bold, dim, red, brblue, { debug, info, error },                                \
+            { debug_title, title_end, title_end },                                            \
+            { sizeof(debug) - 1, sizeof(info) - 1, sizeof(error) - 1 },                       \
+            { sizeof(debug_title) - 1, sizeof(title_end) - 1, sizeof(title_end) - 1 }         \
+    }
+
+const CliStyle CLI_STYLE_PLAIN
+    = CLI_STYLE_("", "", "", "", "", CLI_ERROR_SYM " ", CLI_INFO_SYM " ", "", "Debug: ", ": ");
+const CliStyle CLI_STYLE_ANSI = CLI_STYLE_(
+    CLI_RESET_SEQ, CLI_BOLD_SEQ, CLI_DIM_SEQ, CLI_FORE_RED_SEQ, CLI_FORE_BRBLUE_SEQ,
+    CLI_FORE_RED_SEQ CLI_ERROR_SYM CLI_RESET_SEQ CLI_BOLD_SEQ " ",
+    CLI_FORE_BRBLUE_SEQ CLI_INFO_SYM CLI_RESET_SEQ CLI_BOLD_SEQ " ", CLI_DIM_SEQ,
+    CLI_RESET_SEQ CLI_BOLD_SEQ "Debug" CLI_RESET_SEQ ": ", CLI_RESET_SEQ ": "
+);
+
+// The style of streams without a bound style (see cli_toggle_styles()).
+static const CliStyle* cli_default_style = &CLI_STYLE_PLAIN;
+
+// Styles bound to stdin, stdout and stderr (NULL if not bound).
+#define CLI_STYLE_FDS 3
+static const CliStyle* cli_styles[CLI_STYLE_FDS];
+
+/*
+ * Write a message of `level` without format arguments with a single writev(2)
+ * (or fwrite() calls if writev(2) is not available).
+ *
+ * `title` and `msg` are string literals, so their lengths are known at compile
+ * time and no formatting is needed.
+ */
+int cli_write_message_(
+    enum CliLevel level, const char* title, size_t title_length, const char* msg, size_t msg_length
+);
+
+/*
+ * Format a message of `level` into a stack buffer and write it at once.
+ *
+ * The style is loaded once, so a message is never printed with parts of two
+ * styles.
+ */
+int cli_printf_message_(
+    enum CliLevel level, const char* title, size_t title_length, const char* format, ...
+);
+
+#ifdef CLI_HAS_WRITEV
+/*
+ * Same as cli_printf_message_(), but async-signal-safe: the message is always
+ * written to stderr with write(2) from a stack buffer, and no locks are taken
+ * and no memory is allocated (`CliWriter` and the log ring are not used).
+ *
+ * `format` only supports %s, %c, %d, %i, %u, %x and %p (with `l`, `ll` and `z`
+ * modifiers) and %%, without flags, widths and precisions. An unsupported
+ * conversion and the rest of `format` are written as is, without reading their
+ * arguments. `errno` is kept.
+ */
+int cli_printf_message_safe_(
+    enum CliLevel level, const char* title, size_t title_length, const char* format, ...
+);
+#endif // CLI_HAS_WRITEV
+
+#ifndef CLI_LOG_LEVEL
+#define CLI_LOG_LEVEL 0
+#endif
+
+// The runtime level (see cli_set_log_level()).
+static int cli_log_level = CLI_LOG_LEVEL;
+
+// A disabled message costs a single branch, and its arguments are not evaluated.
+#define cli_is_enabled_(level)                                            \
+    CLI_UNLIKELY((int)(level) >= CLI_ATOMIC_LOAD_RELAXED(&cli_log_level))
+
+// A message below CLI_LOG_LEVEL is still type-checked, but never compiled. A call (instead of 0)
+// keeps a statement with a disabled macro from warnings about no effect.
+static inline int cli_compiled_out(void) {
+    return 0;
+}
+
+#define cli_compiled_out_(call) (0 ? (call) : cli_compiled_out())
+
+#define cli_print_(level, title, msg)                                                          \
+    (cli_is_enabled_(level)                                                                    \
+         ? cli_write_message_(level, title, sizeof(title) - 1, msg "\n", sizeof(msg "\n") - 1) \
+         : 0)
+
+#define cli_printf_(level, title, msg, ...)                                            \
+    (cli_is_enabled_(level)                                                            \
+         ? cli_printf_message_(level, title, sizeof(title) - 1, msg "\n", __VA_ARGS__) \
+         : 0)
+
+#define cli_printf_safe_(level, title, msg, ...)                                            \
+    (cli_is_enabled_(level)                                                                 \
+         ? cli_printf_message_safe_(level, title, sizeof(title) - 1, msg "\n", __VA_ARGS__) \
+         : 0)
+
+#if CLI_LOG_LEVEL <= 2
+#define cli_print_error_       cli_print_
+#define cli_printf_error_      cli_printf_
+#define cli_printf_error_safe_ cli_printf_safe_
+#else
+#define cli_print_error_(level, title, msg)       cli_compiled_out_(cli_print_(level, title, msg))
+#define cli_printf_error_(level, title, msg, ...)                  \
+    cli_compiled_out_(cli_printf_(level, title, msg, __VA_ARGS__))
+#define cli_printf_error_safe_(level, title, msg, ...)                  \
+    cli_compiled_out_(cli_printf_safe_(level, title, msg, __VA_ARGS__))
+#endif
+
+#if CLI_LOG_LEVEL <= 1
+#define cli_print_info_       cli_print_
+#define cli_printf_info_      cli_printf_
+#define cli_printf_info_safe_ cli_printf_safe_
+#else
+#define cli_print_info_(level, title, msg)       cli_compiled_out_(cli_print_(level, title, msg))
+#define cli_printf_info_(level, title, msg, ...)                   \
+    cli_compiled_out_(cli_printf_(level, title, msg, __VA_ARGS__))
+#define cli_printf_info_safe_(level, title, msg, ...)                   \
+    cli_compiled_out_(cli_printf_safe_(level, title, msg, __VA_ARGS__))
+#endif
+
+#if CLI_LOG_LEVEL <= 0
+#define cli_printf_debug_ cli_printf_
+#else
+#define cli_printf_debug_(level, title, msg, ...)                  \
+    cli_compiled_out_(cli_printf_(level, title, msg, __VA_ARGS__))
+#endif
+
+// cli_print_error() and cli_print_info() write `title` and `msg` as is, without formatting (so "%%"
+// is printed as two characters, unlike printf variants).
+#ifndef cli_print_error
+#define cli_print_error(title, msg) cli_print_error_(CliLevelError, title, msg)
+#endif
+
+#ifndef cli_printf_error
+#define cli_printf_error(title, msg, ...)                     \
+    cli_printf_error_(CliLevelError, title, msg, __VA_ARGS__)
+#endif
+
+#ifndef cli_print_info
+#define cli_print_info(title, msg) cli_print_info_(CliLevelInfo, title, msg)
+#endif
+
+#ifndef cli_printf_info
+#define cli_printf_info(title, msg, ...) cli_printf_info_(CliLevelInfo, title, msg, __VA_ARGS__)
+#endif
+
+#ifndef cli_printf_debug
+#define cli_printf_debug(msg, ...)                                                         \
+    cli_printf_debug_(CliLevelDebug, __FILE__ ":" CLI_STR(__LINE__) ":", msg, __VA_ARGS__)
+#endif
+
+#ifdef CLI_HAS_WRITEV
+// Async-signal-safe variants for signal handlers and children after fork() (see
+// cli_printf_message_safe_()).
+#ifndef cli_print_error_safe
+#define cli_print_error_safe(title, msg) cli_printf_error_safe_(CliLevelError, title, "%s", msg)
+#endif
+
+#ifndef cli_printf_error_safe
+#define cli_printf_error_safe(title, msg, ...)                     \
+    cli_printf_error_safe_(CliLevelError, title, msg, __VA_ARGS__)
+#endif
+
+#ifndef cli_print_info_safe
+#define cli_print_info_safe(title, msg) cli_printf_info_safe_(CliLevelInfo, title, "%s", msg)
+#endif
+
+#ifndef cli_printf_info_safe
+#define cli_printf_info_safe(title, msg, ...)                    \
+    cli_printf_info_safe_(CliLevelInfo, title, msg, __VA_ARGS__)
+#endif
+#endif // CLI_HAS_WRITEV
+
+// The state of cli_rate_limited() for a call site.
+struct CliRateLimit {
+    unsigned long long second;
+    unsigned int count;
+};
+
+// Returns true if less than `per_second` calls were allowed during the current second.
+static inline bool cli_rate_limit_(struct CliRateLimit* limit, unsigned int per_second) {
+    unsigned long long now = (unsigned long long)time(NULL);
+    unsigned long long second = CLI_ATOMIC_LOAD_RELAXED(&limit->second);
+    if (second != now && CLI_ATOMIC_CAS(&limit->second, &second, now)) {
+        CLI_ATOMIC_STORE(&limit->count, 0u);
+    }
+    return CLI_ATOMIC_ADD(&limit->count, 1u) < per_second;
+}
+
+/*
+ * Run `statement` (e.g. a call of cli_printf_error()) at most `per_second`
+ * times per second at this call site. Other calls are skipped.
+ *
+ * For example:
+ *     cli_rate_limited(10, cli_printf_error("Uh-oh", "Request %d failed.", id));
+ */
+#define cli_rate_limited(per_second, statement)                     \
+    do {                                                            \
+        static struct CliRateLimit cli_limit_;                      \
+        if (cli_rate_limit_(&cli_limit_, (unsigned)(per_second))) { \
+            statement;                                              \
+        }                                                           \
+    } while (0)
+
+void cli_set_log_level(enum CliLevel level) {
+    CLI_ATOMIC_STORE(&cli_log_level, (int)level);
+}
+
+enum CliLevel cli_get_log_level(void) {
+    return (enum CliLevel)CLI_ATOMIC_LOAD_RELAXED(&cli_log_level);
+}
+
+void cli_toggle_styles(void) {
+#ifndef CLI_NO_STYLES
+    const CliStyle* style = CLI_ATOMIC_LOAD(&cli_default_style);
+    const CliStyle* toggled;
+    do {
+        toggled = style == &CLI_STYLE_ANSI ? &CLI_STYLE_PLAIN : &CLI_STYLE_ANSI;
+    } while (!CLI_ATOMIC_CAS(&cli_default_style, &style, toggled));
+
+    CLI_RESET = toggled->reset;
+    CLI_BOLD = toggled->bold;
+    CLI_DIM = toggled->dim;
+    CLI_FORE_RED = toggled->fore_red;
+    CLI_FORE_BRBLUE = toggled->fore_brblue;
 #endif // CLI_NO_STYLES
 }
 
+const CliStyle* cli_get_style(int fd) {
+    const CliStyle* style = NULL;
+    if (fd >= 0 && fd < CLI_STYLE_FDS) {
+        style = CLI_ATOMIC_LOAD(&cli_styles[fd]);
+    }
+    return style ? style : CLI_ATOMIC_LOAD(&cli_default_style);
+}
+
+void cli_set_style(int fd, const CliStyle* style) {
+    if (fd >= 0 && fd < CLI_STYLE_FDS) {
+        CLI_ATOMIC_STORE(&cli_styles[fd], style);
+    }
+}
+
+const CliStyle* cli_detect_style(int fd) {
+    if (fd < 0 || fd >= CLI_STYLE_FDS) {
+        return CLI_ATOMIC_LOAD(&cli_default_style);
+    }
+    const CliStyle* style = CLI_ATOMIC_LOAD(&cli_styles[fd]);
+    if (style) {
+        return style;
+    }
+
+    const CliStyle* detected = &CLI_STYLE_PLAIN;
+#if !defined(CLI_NO_STYLES) && defined(CLI_HAS_ISATTY)
+    const char* no_color = getenv("NO_COLOR");
+    if (isatty(fd) && !(no_color && no_color[0])) {
+        detected = &CLI_STYLE_ANSI;
+    }
+#endif
+    // If another thread has bound a style meanwhile, `style` is set to it.
+    return CLI_ATOMIC_CAS(&cli_styles[fd], &style, detected) ? detected : style;
+}
+
 #ifdef CLI_NOHEAP_IMPLEMENTATION
-#define cli_da_init(array, _, __)                                                          \
+#define cli_da_init(array, block)                                                          \
     {                                                                                      \
+        (void)(block);                                                                     \
         CLI_ASSERT(                                                                        \
             (array).stack                                                                  \
             && "(" #array                                                                  \
@@ -329,118 +1573,2866 @@ typedef unsigned char bool
     }
 
 enum CliError cli_parse_noheap(int argc, char** argv, struct Cli* cli, const char** stack) {
-    const char** unused = stack;
-
-    cli->args = (struct CliArray) { .stack = stack, .next_unused = &unused };
-    cli->cmd_options = (struct CliArray) { .stack = stack, .next_unused = &unused };
-    cli->program_options = (struct CliArray) { .stack = stack, .next_unused = &unused };
+    // Arrays share the cursor through `cli`, so it stays valid after returning.
+    cli->next_unused = stack;
+    struct CliArray* arrays[] = { &cli->args, &cli->cmd_options, &cli->program_options };
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        memset(arrays[i], 0, sizeof(*arrays[i]));
+        arrays[i]->stack = stack;
+        arrays[i]->next_unused = &cli->next_unused;
+    }
+#ifdef CLI_STATS
+    memset(&cli->stats, 0, sizeof(cli->stats));
+#endif
 
     return cli_parse(argc, argv, cli);
 }
 #endif // CLI_NOHEAP_IMPLEMENTATION
 
+// On the heap, all arrays are carved out of a single block of `argc` items (see cli_parse()).
+// cli_parse() only accepts options before positional arguments and positional arguments before
+// command options, so each array occupies a contiguous range of the block:
+//     [program_options][args][cmd_options]
+// `next_unused` is a local variable of cli_parse() that points to a next unused item of the block.
 #ifndef cli_da_init
-#define cli_da_init(array, item_t, da_malloc)                                      \
-    {                                                                              \
-        (array).capacity = CLI_DEFAULT_ARR_CAP;                                    \
-        (array).length = 0;                                                        \
-        (array).data = (item_t*)(da_malloc)(CLI_DEFAULT_ARR_CAP * sizeof(item_t)); \
+#define cli_da_init(array, block) \
+    {                             \
+        (array).capacity = 0;     \
+        (array).length = 0;       \
+        (array).data = (block);   \
     }
 #endif
 
 #ifndef cli_da_append
-#define cli_da_append(array, item)                                                           \
-    {                                                                                        \
-        if (++(array).length > (array).capacity) {                                           \
-            (array).capacity *= 2;                                                           \
-            (array).data                                                                     \
-                = (typeof(item)*)CLI_REALLOC((array).data, (array).capacity * sizeof(item)); \
-            if ((array).data == NULL) {                                                      \
-                cli_print_error(                                                             \
-                    "Memory error", "Unable to reallocate memory for more array items."      \
-                );                                                                           \
-                CLI_ASSERT(0 && "Memory error");                                             \
-            }                                                                                \
-        }                                                                                    \
-        (array).data[(array).length - 1] = (item);                                           \
+#define cli_da_append(array, item)              \
+    {                                           \
+        if ((array).length == 0) {              \
+            (array).data = next_unused;         \
+        }                                       \
+        *next_unused++ = CLI_ITEM(array, item); \
+        (array).capacity = ++(array).length;    \
     }
 #endif
 
+#ifdef CLI_COMPACT
+#define CLI_ITEM(array, arg) ((CliItem)((uintptr_t)(arg) - (uintptr_t)(array).base))
+#else
+#define CLI_ITEM(array, arg) (arg)
+#endif
+
 static const char* cli_pop_argv(int* argc, char*** argv) {
     CLI_ASSERT(*argc);
     (*argc)--;
     return *((*argv)++);
 }
 
-enum CliError cli_parse(int argc, char** argv, Cli* cli) {
-    const char* execfile = cli_pop_argv(&argc, &argv);
-    if (argc > 0) {
-        cli->execfile = execfile;
-        cli_da_init(cli->args, const char*, CLI_MALLOC);
-        if (cli->args.data == NULL) {
-            cli_print_error("Memory error", "Unable to allocate memory for CLI arguments.");
-            return CliErrorFatal;
-        }
-        cli_da_init(cli->cmd_options, const char*, CLI_MALLOC);
-        if (cli->cmd_options.data == NULL) {
-            cli_print_error("Memory error", "Unable to allocate memory for command options.");
-            return CliErrorFatal;
-        }
-        cli_da_init(cli->program_options, const char*, CLI_MALLOC);
-        if (cli->program_options.data == NULL) {
-            cli_print_error("Memory error", "Unable to allocate memory for program options.");
-            return CliErrorFatal;
-        }
+#ifdef CLI_SHORT_FLAGS
+// Set bits of characters of a program option `arg` with one dash (e.g. `a`, `b` and `c` of `-abc`).
+static void cli_add_short_flags(Cli* cli, const char* arg) {
+    if (arg[1] == '-') {
+        return;
+    }
+    for (const char* c = arg + 1; *c != '\0' && *c != '='; c++) {
+        unsigned char bit = (unsigned char)*c;
+        cli->short_flags[bit >> 6] |= 1ull << (bit & 63);
+    }
+}
+#endif
 
-        const char* arg;
-        bool is_cmd_option = false;
-        while (argc) {
-            arg = cli_pop_argv(&argc, &argv);
-            if (arg[0] == '-') {
-                struct CliArray* option_array
-                    = is_cmd_option ? &cli->cmd_options : &cli->program_options;
-
-                if (arg[1] == '-' && arg[2] == '\0') {
-                    if (cli->args.length > 0) {
-                        cli_printf_error(
-                            "CLI error",
-                            "Double dash ('%s') cannot be specified after the positional argument "
-                            "('%s').",
-                            arg, *(char**)(&cli->args.data[cli->args.length - 1])
-                        );
-                        return CliErrorUser;
-                    }
-                    is_cmd_option = true;
-                } else {
-                    cli_da_append(*option_array, arg);
-                }
-            } else {
-                if (cli->cmd_options.length > 0) {
-                    cli_printf_error(
-                        "CLI error",
-                        "Positional arguments ('%s') should be specified prior to command options.",
-                        arg
-                    );
-                    return CliErrorUser;
-                }
-                cli_da_append(cli->args, arg);
-                is_cmd_option = true;
-            }
-        }
-    } else {
-        *cli = (struct Cli) { 0 };
-        cli->execfile = execfile;
+#ifdef CLI_VIEWS
+// Count arguments that start with a dash, i.e. options and double dashes.
+static size_t cli_count_options(int argc, char** argv) {
+    size_t options = 0;
+    for (int i = 0; i < argc; i++) {
+        options += argv[i][0] == '-';
     }
-    return CliErrorOk;
+    return options;
 }
 
-inline void cli_free(Cli* cli) {
-#ifdef CLI_NOHEAP
-    (void)cli;
+#ifdef CLI_SIMD_WIDTH
+// Find the first '=' or '\0' in `str`, CLI_SIMD_WIDTH bytes at a time.
+//
+// Loads are aligned to CLI_SIMD_WIDTH and never cross a page boundary, so reading bytes around
+// `str` is safe (similarly to strlen() of libc), but not for AddressSanitizer.
+CLI_NO_SANITIZE_ADDRESS static const char* cli_find_name_end(const char* str) {
+    size_t misalignment = (uintptr_t)str & (CLI_SIMD_WIDTH - 1);
+    const char* chunk = str - misalignment;
+
+    // Bytes before `str` are ignored.
+    cli_simd_mask_t mask = cli_simd_find_name_end(chunk) >> (misalignment * CLI_SIMD_MASK_BITS);
+    if (mask) {
+        return str + cli_simd_ctz(mask) / CLI_SIMD_MASK_BITS;
+    }
+    do {
+        chunk += CLI_SIMD_WIDTH;
+        mask = cli_simd_find_name_end(chunk);
+    } while (!mask);
+    return chunk + cli_simd_ctz(mask) / CLI_SIMD_MASK_BITS;
+}
 #else
-    CLI_FREE(cli->args.data);
-    CLI_FREE(cli->cmd_options.data);
-    CLI_FREE(cli->program_options.data);
+static const char* cli_find_name_end(const char* str) {
+    while (*str != '\0' && *str != '=') {
+        str++;
+    }
+    return str;
+}
+#endif // CLI_SIMD_WIDTH
+
+// Split `arg` that starts with a dash into `option`.
+static void cli_split_option(const char* arg, struct CliOption* option) {
+    option->dashes = arg[1] == '-' ? 2 : 1;
+    option->name = arg + option->dashes;
+
+    const char* end = cli_find_name_end(option->name);
+    option->name_length = end - option->name;
+
+    if (*end == '=') {
+        option->value = end + 1;
+        option->value_length = strlen(option->value);
+    } else {
+        option->value = NULL;
+        option->value_length = 0;
+    }
+#ifdef CLI_INDEX
+    option->converted_kind = 0;
+#endif
+}
+
+enum CliError cli_schema_error(Cli* cli, const char* option, enum CliSchemaError error) {
+    switch (error) {
+    case CliSchemaErrorUnknown:
+        cli_printf_error("CLI error", "Unknown option ('%s').", option);
+        break;
+    case CliSchemaErrorValue:
+        cli_printf_error("CLI error", "Option ('%s') does not take a value.", option);
+        break;
+    case CliSchemaErrorNoValue:
+        cli_printf_error("CLI error", "Option ('%s') requires a value (e.g. '%s=1').", option, option);
+        break;
+    }
+    cli_free(cli);
+    return CliErrorUser;
+}
+#endif // CLI_VIEWS
+
+#ifdef CLI_STATS
+// Clocks need POSIX or C11, so parse time is always 0 with strict C99 (e.g. -std=c99).
+static unsigned long long cli_now_ns(void) {
+#if defined(CLOCK_MONOTONIC) || (__STDC_VERSION__ >= 201112L && defined(TIME_UTC))
+    struct timespec now;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return (unsigned long long)now.tv_sec * 1000000000u + (unsigned long long)now.tv_nsec;
+#else
+    return 0;
+#endif
+}
+#endif // CLI_STATS
+
+#ifndef CLI_NOHEAP
+// Memory of `cli` is allocated, reallocated and freed with its allocator by these functions, so
+// CLI_STATS counts all of it.
+static void* cli_allocate(Cli* cli, size_t size) {
+    void* ptr = (cli->allocator.alloc)(cli->allocator.ctx, size);
+#ifdef CLI_STATS
+    cli->stats.allocations++;
+    if (ptr) {
+        cli->stats.bytes += size;
+        if (cli->stats.bytes > cli->stats.peak_bytes) {
+            cli->stats.peak_bytes = cli->stats.bytes;
+        }
+    }
+#endif
+    return ptr;
+}
+
+#ifdef CLI_STREAM
+static void* cli_reallocate(Cli* cli, void* ptr, size_t old_size, size_t new_size) {
+    void* result = (cli->allocator.realloc)(cli->allocator.ctx, ptr, old_size, new_size);
+#ifdef CLI_STATS
+    cli->stats.reallocations++;
+    if (result) {
+        cli->stats.bytes += new_size - old_size;
+        if (cli->stats.bytes > cli->stats.peak_bytes) {
+            cli->stats.peak_bytes = cli->stats.bytes;
+        }
+    }
+#endif
+    return result;
+}
+#endif // CLI_STREAM
+
+static void cli_release(Cli* cli, void* ptr, size_t size) {
+    (cli->allocator.free)(cli->allocator.ctx, ptr, size);
+#ifdef CLI_STATS
+    cli->stats.bytes -= size;
+#endif
+}
+#endif // CLI_NOHEAP
+
+#ifdef CLI_INDEX
+#ifdef CLI_LAYERS
+// Options of a layer, their names and the index over all options are a single allocation that
+// follows the header.
+struct CliLayer {
+    struct CliLayer* next;
+    // Layers are sorted by ranks, and layers of the same rank by the order of loading.
+    int rank;
+    size_t size;
+    struct CliOption* options;
+    size_t length;
+#ifdef CLI_CONFIG
+    // A config file mapped to memory that options point to (NULL for other layers).
+    char* mapping;
+    size_t mapping_size;
+#endif
+};
+
+static void cli_free_layers(Cli* cli) {
+    struct CliLayer* layer = cli->layers;
+    while (layer) {
+        struct CliLayer* next = layer->next;
+#ifdef CLI_CONFIG
+        if (layer->mapping) {
+            munmap(layer->mapping, layer->mapping_size);
+        }
+#endif
+        cli_release(cli, layer, layer->size);
+        layer = next;
+    }
+    cli->layers = NULL;
+}
+#endif // CLI_LAYERS
+
+// Hash a name of `option` with FNV-1a. Dashes are a part of the name.
+static unsigned int cli_hash_option(const struct CliOption* option) {
+    unsigned int hash = (2166136261u ^ option->dashes) * 16777619u;
+    for (size_t i = 0; i < option->name_length; i++) {
+        hash = (hash ^ (unsigned char)option->name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Count slots of the index for `options`. At least a half of slots is always empty.
+static size_t cli_index_capacity(size_t options) {
+    size_t capacity = 1;
+    while (capacity < options * 2) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static struct CliOption* cli_index_option(const Cli* cli, size_t offset) {
+    size_t cmd_start = cli->program_options.length + cli->args.length;
+    if (offset < cmd_start) {
+        return &cli->program_options.options[offset];
+    }
+    offset -= cmd_start;
+#ifdef CLI_LAYERS
+    if (offset >= cli->cmd_options.length) {
+        // Layers follow command options.
+        offset -= cli->cmd_options.length;
+        struct CliLayer* layer = cli->layers;
+        for (; offset >= layer->length; layer = layer->next) {
+            offset -= layer->length;
+        }
+        return &layer->options[offset];
+    }
+#endif
+    return &cli->cmd_options.options[offset];
+}
+
+// Find a slot for an option with the same name as `key`. If the option is not found, returns
+// an empty slot.
+static unsigned int*
+cli_index_find(const Cli* cli, const struct CliOption* key, unsigned int hash, bool is_cmd_option) {
+    size_t cmd_start = cli->program_options.length + cli->args.length;
+    size_t cmd_end = cmd_start + cli->cmd_options.length;
+
+    unsigned int i = hash & cli->index_mask;
+    for (; cli->index[i]; i = (i + 1) & cli->index_mask) {
+        size_t offset = cli->index[i] - 1;
+        if ((offset >= cmd_start && offset < cmd_end) != is_cmd_option) {
+            continue;
+        }
+
+        const struct CliOption* option = cli_index_option(cli, offset);
+        if (option->dashes == key->dashes && option->name_length == key->name_length
+            && memcmp(option->name, key->name, key->name_length) == 0) {
+            break;
+        }
+    }
+    return &cli->index[i];
+}
+
+static void cli_index_insert(Cli* cli, size_t offset, bool is_cmd_option) {
+    const struct CliOption* option = cli_index_option(cli, offset);
+    // Later options replace earlier ones with the same name.
+    *cli_index_find(cli, option, cli_hash_option(option), is_cmd_option) = (unsigned int)offset + 1;
+}
+
+static void cli_index_build(Cli* cli) {
+    size_t cmd_start = cli->program_options.length + cli->args.length;
+
+#ifdef CLI_LAYERS
+    // Layers are inserted first, so that options of the command line replace them.
+    size_t offset = cmd_start + cli->cmd_options.length;
+    for (const struct CliLayer* layer = cli->layers; layer; layer = layer->next) {
+        for (size_t i = 0; i < layer->length; i++) {
+            cli_index_insert(cli, offset + i, false);
+        }
+        offset += layer->length;
+    }
+#endif
+
+    for (size_t i = 0; i < cli->program_options.length; i++) {
+        cli_index_insert(cli, i, false);
+    }
+    for (size_t i = 0; i < cli->cmd_options.length; i++) {
+        cli_index_insert(cli, cmd_start + i, true);
+    }
+}
+
+static struct CliOption* cli_index_lookup(const Cli* cli, const char* name, bool is_cmd_option) {
+    if (cli->index == NULL || name[0] != '-') {
+        return NULL;
+    }
+
+    struct CliOption key;
+    cli_split_option(name, &key);
+    unsigned int slot = *cli_index_find(cli, &key, cli_hash_option(&key), is_cmd_option);
+    return slot ? cli_index_option(cli, slot - 1) : NULL;
+}
+
+static const char* cli_index_get(const Cli* cli, const char* name, bool is_cmd_option) {
+    const struct CliOption* option = cli_index_lookup(cli, name, is_cmd_option);
+    if (option == NULL) {
+        return NULL;
+    }
+    return option->value ? option->value : option->name + option->name_length;
+}
+
+const char* cli_get_option(const Cli* cli, const char* name) {
+    return cli_index_get(cli, name, false);
+}
+
+bool cli_has_flag(const Cli* cli, const char* name) {
+    return cli_index_get(cli, name, false) != NULL;
+}
+
+const char* cli_get_cmd_option(const Cli* cli, const char* name) {
+    return cli_index_get(cli, name, true);
+}
+
+bool cli_has_cmd_flag(const Cli* cli, const char* name) {
+    return cli_index_get(cli, name, true) != NULL;
+}
+
+// Kinds of `CliOption.converted`.
+enum CliConverted {
+    CliConvertedNone,
+    CliConvertedInt,
+    CliConvertedU64,
+    CliConvertedDouble,
+    CliConvertedBool,
+    CliConvertedSize
+};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// Check whether 8 bytes loaded from memory are decimal digits. Adding 6 to a digit does not carry
+// into the high nibble, so both the byte and the sum have the high nibble 3 only for digits.
+static bool cli_are_8_digits(unsigned long long chunk) {
+    return (((chunk & 0xF0F0F0F0F0F0F0F0ull)
+             | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+            == 0x3333333333333333ull);
+}
+
+// Convert 8 digits loaded from memory (the first digit is the lowest byte) to an integer. Pairs,
+// quads and halves of digits are combined with 3 multiplications instead of 8.
+static unsigned int cli_convert_8_digits(unsigned long long chunk) {
+    chunk -= 0x3030303030303030ull;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32)))
+             + (((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))))
+            >> 32;
+    return (unsigned int)chunk;
+}
+#endif
+
+// Convert decimal digits of `str` to `value`. Returns false if there are no digits, another
+// character or an overflow.
+static bool cli_convert_u64(const char* str, size_t length, unsigned long long* value) {
+    unsigned long long result = 0;
+    size_t i = 0;
+    if (length == 0) {
+        return false;
+    }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; length - i >= 8; i += 8) {
+        unsigned long long chunk;
+        memcpy(&chunk, str + i, 8);
+        if (!cli_are_8_digits(chunk)) {
+            break;
+        }
+
+        unsigned int digits = cli_convert_8_digits(chunk);
+        if (result > (ULLONG_MAX - digits) / 100000000) {
+            return false;
+        }
+        result = result * 100000000 + digits;
+    }
+#endif
+    for (; i < length; i++) {
+        unsigned int digit = (unsigned char)str[i] - '0';
+        if (digit > 9 || result > (ULLONG_MAX - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    *value = result;
+    return true;
+}
+
+static bool cli_convert_int(const char* str, size_t length, long long* value) {
+    bool is_negative = length && str[0] == '-';
+    size_t sign = length && (str[0] == '-' || str[0] == '+');
+
+    unsigned long long magnitude;
+    if (!cli_convert_u64(str + sign, length - sign, &magnitude)
+        || magnitude > (unsigned long long)LLONG_MAX + is_negative) {
+        return false;
+    }
+    // Negating the magnitude in unsigned arithmetic also handles LLONG_MIN.
+    *value = is_negative ? (long long)(0 - magnitude) : (long long)magnitude;
+    return true;
+}
+
+static bool cli_convert_size(const char* str, size_t length, unsigned long long* value) {
+    unsigned int shift = 0;
+    if (length) {
+        switch (str[length - 1]) {
+        case 'k':
+        case 'K':
+            shift = 10;
+            break;
+        case 'm':
+        case 'M':
+            shift = 20;
+            break;
+        case 'g':
+        case 'G':
+            shift = 30;
+            break;
+        case 't':
+        case 'T':
+            shift = 40;
+            break;
+        }
+    }
+
+    unsigned long long result;
+    if (!cli_convert_u64(str, length - (shift != 0), &result) || result > SIZE_MAX >> shift) {
+        return false;
+    }
+    *value = result << shift;
+    return true;
+}
+
+// Compare `str` with a lowercase `word` ignoring the ASCII case.
+static bool cli_is_word(const char* str, size_t length, const char* word) {
+    size_t i = 0;
+    for (; i < length && word[i] != '\0'; i++) {
+        if ((str[i] | 0x20) != word[i]) {
+            return false;
+        }
+    }
+    return i == length && word[i] == '\0';
+}
+
+static bool cli_convert_bool(const char* str, size_t length, unsigned long long* value) {
+    if (length == 1 && (str[0] == '0' || str[0] == '1')) {
+        *value = str[0] == '1';
+        return true;
+    }
+    if (cli_is_word(str, length, "true") || cli_is_word(str, length, "yes")
+        || cli_is_word(str, length, "on")) {
+        *value = true;
+        return true;
+    }
+    if (cli_is_word(str, length, "false") || cli_is_word(str, length, "no")
+        || cli_is_word(str, length, "off")) {
+        *value = false;
+        return true;
+    }
+    return false;
+}
+
+// Convert a number `str` of `length` bytes with strtod() (that is the slow path of
+// cli_convert_double()).
+//
+// strtod() expects the decimal point of the locale (e.g. ',' in de_DE), so '.' is replaced with it
+// in a copy of the number. Short numbers are copied to the stack, and others to `cli->allocator`.
+static bool cli_strtod(Cli* cli, const char* str, size_t length, double* value) {
+    const char* point = localeconv()->decimal_point;
+    size_t point_length = strlen(point);
+    char stack[64];
+    size_t size = length * (point_length > 0 ? point_length : 1) + 1;
+    char* copy = size <= sizeof(stack) ? stack : (char*)cli_allocate(cli, size);
+    if (copy == NULL) {
+        return false;
+    }
+    char* next = copy;
+    for (size_t i = 0; i < length; i++) {
+        if (str[i] == '.') {
+            memcpy(next, point, point_length);
+            next += point_length;
+        } else {
+            *next++ = str[i];
+        }
+    }
+    *next = '\0';
+
+    char* end;
+    *value = strtod(copy, &end);
+    bool is_valid = end == next && *value >= -DBL_MAX && *value <= DBL_MAX;
+    if (copy != stack) {
+        cli_release(cli, copy, size);
+    }
+    return is_valid;
+}
+
+// Convert a decimal number `str` (terminated after `length` bytes) to `value`.
+//
+// If the number has at most 19 significant digits and its decimal exponent is within [-22, 22],
+// both the digits (below 2^53) and the power of 10 are exact doubles, so a single multiplication or
+// division is correctly rounded (Clinger's fast path). Other numbers are passed to strtod().
+static bool cli_convert_double(Cli* cli, const char* str, size_t length, double* value) {
+    static const double powers[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    size_t i = length && (str[0] == '-' || str[0] == '+');
+    if (i == length || !(str[i] == '.' || (str[i] >= '0' && str[i] <= '9'))) {
+        return false; // Excludes spaces, `inf` and `nan` that strtod() accepts.
+    }
+
+    // Digits after the 19th significant one overflow `digits`, but such numbers use strtod().
+    unsigned long long digits = 0;
+    int digit_count = 0;
+    int exponent = 0;
+    bool has_digits = false;
+    for (; i < length && str[i] >= '0' && str[i] <= '9'; i++) {
+        digits = digits * 10 + (str[i] - '0');
+        digit_count += digits != 0;
+        has_digits = true;
+    }
+    if (i < length && str[i] == '.') {
+        for (i++; i < length && str[i] >= '0' && str[i] <= '9'; i++) {
+            digits = digits * 10 + (str[i] - '0');
+            digit_count += digits != 0;
+            exponent--;
+            has_digits = true;
+        }
+    }
+    if (!has_digits) {
+        return false;
+    }
+    if (i < length && (str[i] == 'e' || str[i] == 'E')) {
+        long long power;
+        const char* power_str = str + i + 1;
+        if (cli_convert_int(power_str, length - i - 1, &power) && power >= -1000 && power <= 1000) {
+            exponent += (int)power;
+        } else {
+            digit_count = INT_MAX; // Let strtod() check the exponent.
+        }
+        i = length;
+    }
+    if (i != length) {
+        return false;
+    }
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    if (digit_count <= 19 && digits <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        double result = (double)digits;
+        result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+        *value = str[0] == '-' ? -result : result;
+        return true;
+    }
+#else
+    (void)powers;
+#endif
+    return cli_strtod(cli, str, length, value);
+}
+
+// Find a program option `name` and convert its value to `kind` (unless it is already converted).
+// Saves NULL to `result` if the option is not specified or invalid.
+static enum CliError cli_get_converted(
+    Cli* cli, const char* name, enum CliConverted kind, const struct CliOption** result
+) {
+    struct CliOption* option = cli_index_lookup(cli, name, false);
+    *result = NULL;
+    if (option == NULL) {
+        return CliErrorOk;
+    }
+    if (option->converted_kind == kind) {
+        *result = option;
+        return CliErrorOk;
+    }
+
+    const char* value = option->value;
+    size_t length = option->value_length;
+    bool is_valid = false;
+    const char* expected = "";
+    const char* example = "";
+    switch (kind) {
+    case CliConvertedInt:
+        is_valid = value && cli_convert_int(value, length, &option->converted.i);
+        expected = "an integer";
+        example = "1";
+        break;
+    case CliConvertedU64:
+        is_valid = value && cli_convert_u64(value, length, &option->converted.u);
+        expected = "a non-negative integer";
+        example = "1";
+        break;
+    case CliConvertedDouble:
+        is_valid = value && cli_convert_double(cli, value, length, &option->converted.d);
+        expected = "a number";
+        example = "0.5";
+        break;
+    case CliConvertedBool:
+        option->converted.u = true;
+        is_valid = value == NULL || cli_convert_bool(value, length, &option->converted.u);
+        expected = "a boolean";
+        example = "yes";
+        break;
+    case CliConvertedSize:
+        is_valid = value && cli_convert_size(value, length, &option->converted.u);
+        expected = "a size";
+        example = "64M";
+        break;
+    case CliConvertedNone:
+        break;
+    }
+
+    if (!is_valid) {
+        // The union can be partially overwritten.
+        option->converted_kind = CliConvertedNone;
+        cli_printf_error(
+            "CLI error", "Option ('%s') requires %s (e.g. '%s=%s').", name, expected, name, example
+        );
+        return CliErrorUser;
+    }
+    option->converted_kind = (unsigned char)kind;
+    *result = option;
+    return CliErrorOk;
+}
+
+enum CliError cli_get_int(Cli* cli, const char* name, long long* value) {
+    const struct CliOption* option;
+    enum CliError error = cli_get_converted(cli, name, CliConvertedInt, &option);
+    if (option) {
+        *value = option->converted.i;
+    }
+    return error;
+}
+
+enum CliError cli_get_u64(Cli* cli, const char* name, unsigned long long* value) {
+    const struct CliOption* option;
+    enum CliError error = cli_get_converted(cli, name, CliConvertedU64, &option);
+    if (option) {
+        *value = option->converted.u;
+    }
+    return error;
+}
+
+enum CliError cli_get_double(Cli* cli, const char* name, double* value) {
+    const struct CliOption* option;
+    enum CliError error = cli_get_converted(cli, name, CliConvertedDouble, &option);
+    if (option) {
+        *value = option->converted.d;
+    }
+    return error;
+}
+
+enum CliError cli_get_bool(Cli* cli, const char* name, bool* value) {
+    const struct CliOption* option;
+    enum CliError error = cli_get_converted(cli, name, CliConvertedBool, &option);
+    if (option) {
+        *value = option->converted.u != 0;
+    }
+    return error;
+}
+
+enum CliError cli_get_size(Cli* cli, const char* name, size_t* value) {
+    const struct CliOption* option;
+    enum CliError error = cli_get_converted(cli, name, CliConvertedSize, &option);
+    if (option) {
+        *value = (size_t)option->converted.u;
+    }
+    return error;
+}
+
+#ifdef CLI_LAYERS
+// Allocate a layer of `options` and `names` bytes of their names and insert it by `rank`. The
+// allocation also has space for the index over all options, so the index is rebuilt by
+// cli_finish_layer() without additional allocations.
+static struct CliLayer*
+cli_add_layer(Cli* cli, int rank, size_t options, size_t names, char** names_data) {
+    size_t total = cli->program_options.length + cli->cmd_options.length + options;
+    for (const struct CliLayer* layer = cli->layers; layer; layer = layer->next) {
+        total += layer->length;
+    }
+    size_t index_capacity = cli_index_capacity(total);
+    size_t size = sizeof(struct CliLayer) + options * sizeof(struct CliOption)
+                + index_capacity * sizeof(unsigned int) + names;
+
+    if (cli->allocator.alloc == NULL) {
+        cli->allocator = cli_default_allocator();
+    }
+    struct CliLayer* layer = (struct CliLayer*)cli_allocate(cli, size);
+    if (layer == NULL) {
+        cli_print_error("Memory error", "Unable to allocate memory for CLI options.");
+        return NULL;
+    }
+    layer->rank = rank;
+    layer->size = size;
+    layer->options = (struct CliOption*)(layer + 1);
+    layer->length = 0;
+#ifdef CLI_CONFIG
+    layer->mapping = NULL;
+#endif
+
+    cli->index = (unsigned int*)(layer->options + options);
+    cli->index_mask = (unsigned int)index_capacity - 1;
+    *names_data = (char*)(cli->index + index_capacity);
+
+    struct CliLayer** next = &cli->layers;
+    while (*next && (*next)->rank <= rank) {
+        next = &(*next)->next;
+    }
+    layer->next = *next;
+    *next = layer;
+    return layer;
+}
+
+// Build the index in the memory of the last added layer after its options are filled.
+static void cli_finish_layer(Cli* cli) {
+    memset(cli->index, 0, (cli->index_mask + 1) * sizeof(unsigned int));
+    cli_index_build(cli);
+}
+#endif // CLI_LAYERS
+
+#ifdef CLI_ENV
+extern char** environ;
+
+// Layers of environment variables override layers of lower ranks.
+#define CLI_RANK_ENV 1
+
+enum CliError cli_load_env(Cli* cli, const char* prefix) {
+    size_t prefix_length = strlen(prefix);
+    size_t options = 0;
+    size_t names = 0;
+    for (char** variable = environ; *variable; variable++) {
+        if (strncmp(*variable, prefix, prefix_length) == 0) {
+            const char* name = *variable + prefix_length;
+            const char* end = strchr(name, '=');
+            if (end && end != name) {
+                options++;
+                names += end - name;
+            }
+        }
+    }
+    if (options == 0) {
+        return CliErrorOk;
+    }
+
+    char* name_data;
+    struct CliLayer* layer = cli_add_layer(cli, CLI_RANK_ENV, options, names, &name_data);
+    if (layer == NULL) {
+        return CliErrorFatal;
+    }
+
+    // `environ` can only be changed by this thread, so the same variables are found again. Names
+    // are converted from `DRY_RUN` to `dry-run`, and values point to the environment.
+    for (char** variable = environ; layer->length < options; variable++) {
+        if (strncmp(*variable, prefix, prefix_length) != 0) {
+            continue;
+        }
+
+        const char* name = *variable + prefix_length;
+        const char* end = strchr(name, '=');
+        if (end == NULL || end == name) {
+            continue;
+        }
+
+        struct CliOption* option = &layer->options[layer->length++];
+        option->dashes = 2;
+        option->name = name_data;
+        option->name_length = end - name;
+        option->value = end + 1;
+        option->value_length = strlen(end + 1);
+        option->converted_kind = CliConvertedNone;
+        for (; name != end; name++) {
+            char c = *name;
+            *name_data++ = c == '_' ? '-' : c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+        }
+    }
+    cli_finish_layer(cli);
+    return CliErrorOk;
+}
+#endif // CLI_ENV
+#endif // CLI_INDEX
+
+#ifndef CLI_NOHEAP
+static bool cli_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/*
+ * Read a next token from `*read` and save it to `token`. If no tokens are left,
+ * `token` is NULL.
+ *
+ * Tokens are separated by whitespace. Like in a shell, quotes ('' and "") and
+ * escapes (\) are supported. Without quotes and inside "", \ escapes the next
+ * character ("" only allows escaping \ and ").
+ *
+ * A token is written to `*write` followed by '\0', so `*write` never passes
+ * `*read`. Thus, when both point to the same string, it is tokenized in place
+ * and tokens are stored one after another. Returns `CliErrorUser` if a quote is
+ * not closed.
+ */
+static enum CliError cli_next_token(char** read, char** write, char** token) {
+    char* r = *read;
+    char* w = *write;
+    while (cli_is_space(*r)) {
+        r++;
+    }
+    if (*r == '\0') {
+        *read = r;
+        *token = NULL;
+        return CliErrorOk;
+    }
+
+    *token = w;
+    char quote = '\0';
+    for (; *r != '\0'; r++) {
+        char c = *r;
+        if (quote == '\'') {
+            if (c == '\'') {
+                quote = '\0';
+            } else {
+                *w++ = c;
+            }
+        } else if (c == '\\' && r[1] != '\0' && (!quote || r[1] == '"' || r[1] == '\\')) {
+            // A line continuation is skipped completely.
+            if (quote || r[1] != '\n') {
+                *w++ = r[1];
+            }
+            r++;
+        } else if (c == '"' && quote) {
+            quote = '\0';
+        } else if ((c == '"' || c == '\'') && !quote) {
+            quote = c;
+        } else if (cli_is_space(c) && !quote) {
+            break;
+        } else {
+            *w++ = c;
+        }
+    }
+    if (quote) {
+        return CliErrorUser;
+    }
+
+    // `w` may be equal to `r`, so the end of the string is checked before writing '\0'.
+    *read = *r == '\0' ? r : r + 1;
+    *w++ = '\0';
+    *write = w;
+    return CliErrorOk;
+}
+#endif // CLI_NOHEAP
+
+#if defined(CLI_RESPONSE_FILES) || defined(CLI_CONFIG)
+/*
+ * Map a file `path` to memory privately for writing and save the mapping to
+ * `data` and its size to `size`. Anonymous pages after the file hold at least
+ * one '\0' and `extra` bytes. `kind` describes the file in errors.
+ */
+static enum CliError
+cli_map_file(const char* path, const char* kind, size_t extra, char** data, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        cli_printf_error("CLI error", "Unable to open %s ('%s', %s).", kind, path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return CliErrorUser;
+    }
+    // Directories and pipes cannot be mapped.
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        cli_printf_error("CLI error", "Unable to open %s ('%s', not a regular file).", kind, path);
+        return CliErrorUser;
+    }
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t file_size = (size_t)st.st_size;
+    *size = (file_size + 1 + extra + page_size - 1) / page_size * page_size;
+
+#ifdef MAP_ANONYMOUS
+    *data = (char*)mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    int error = errno;
+#else
+    // Private pages of /dev/zero are the same as anonymous pages.
+    int zero_fd = open("/dev/zero", O_RDWR);
+    *data = zero_fd < 0 ? (char*)MAP_FAILED
+                        : (char*)mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, zero_fd, 0);
+    int error = errno;
+    if (zero_fd >= 0) {
+        close(zero_fd);
+    }
+#endif
+    if (*data != MAP_FAILED && file_size > 0
+        && mmap(*data, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0)
+               == MAP_FAILED) {
+        error = errno;
+        munmap(*data, *size);
+        *data = (char*)MAP_FAILED;
+    }
+    close(fd);
+    if (*data == MAP_FAILED) {
+        // Only a lack of memory is fatal, other errors are caused by the file.
+        if (error == ENOMEM) {
+            cli_printf_error("Memory error", "Unable to map %s ('%s') to memory.", kind, path);
+            return CliErrorFatal;
+        }
+        cli_printf_error("CLI error", "Unable to map %s ('%s', %s).", kind, path, strerror(error));
+        return CliErrorUser;
+    }
+    return CliErrorOk;
+}
+#endif // CLI_RESPONSE_FILES || CLI_CONFIG
+
+#ifdef CLI_RESPONSE_FILES
+
+// A response file mapped to memory.
+//
+// This struct is stored at the end of the mapping itself, so no allocations are made for it.
+struct CliMapping {
+    struct CliMapping* next;
+    // Tokens of the file stored one after another: "token\0token\0...".
+    char* tokens;
+    size_t token_count;
+    // The size of the mapping that starts at `tokens`.
+    size_t size;
+};
+
+static bool cli_is_response_file(const char* arg) {
+    return arg[0] == '@' && arg[1] != '\0';
+}
+
+// Unmap response files of `cli`. `cli->mappings` is the only owner of them, so it is cleared and
+// a next call (e.g. of cli_free() after a failed parse) does nothing.
+static void cli_unmap_response_files(Cli* cli) {
+    struct CliMapping* mapping = cli->mappings;
+    cli->mappings = NULL;
+    while (mapping) {
+        struct CliMapping* next = mapping->next;
+        munmap(mapping->tokens, mapping->size);
+        mapping = next;
+    }
+}
+
+/*
+ * Map a response file `path` to memory and tokenize it in place.
+ *
+ * The file is mapped privately, so '\0' are written to copy-on-write pages and
+ * the file is not changed. Anonymous pages after the file hold a '\0' after the
+ * last token and `CliMapping`.
+ */
+static enum CliError cli_map_response_file(const char* path, struct CliMapping** result) {
+    char* data;
+    size_t size;
+    enum CliError error
+        = cli_map_file(path, "a response file", sizeof(struct CliMapping), &data, &size);
+    if (error) {
+        return error;
+    }
+
+    struct CliMapping* mapping = (struct CliMapping*)(data + size) - 1;
+    memset(mapping, 0, sizeof(*mapping));
+    mapping->tokens = data;
+    mapping->size = size;
+
+    char* read = data;
+    char* write = data;
+    char* token;
+    while (true) {
+        if (cli_next_token(&read, &write, &token)) {
+            cli_printf_error("CLI error", "A quote is not closed in a response file ('%s').", path);
+            munmap(data, size);
+            return CliErrorUser;
+        }
+        if (token == NULL) {
+            break;
+        }
+        mapping->token_count++;
+    }
+
+    *result = mapping;
+    return CliErrorOk;
+}
+
+/*
+ * Map all response files of the command line to `cli->mappings` (in the same
+ * order) and count how many `items` are needed to store all arguments.
+ */
+static enum CliError cli_map_response_files(int argc, char** argv, Cli* cli, size_t* items) {
+    struct CliMapping** tail = &cli->mappings;
+    *tail = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        if (!cli_is_response_file(argv[i])) {
+            continue;
+        }
+
+        enum CliError error = cli_map_response_file(argv[i] + 1, tail);
+        if (error) {
+            cli_unmap_response_files(cli);
+            return error;
+        }
+        *items += (*tail)->token_count - 1;
+        tail = &(*tail)->next;
+    }
+    return CliErrorOk;
+}
+
+#ifdef CLI_VIEWS
+// Count tokens of response files that start with a dash (see cli_count_options()).
+static size_t cli_count_response_file_options(const struct CliMapping* mapping) {
+    size_t options = 0;
+    for (; mapping; mapping = mapping->next) {
+        const char* token = mapping->tokens;
+        for (size_t i = 0; i < mapping->token_count; i++) {
+            options += token[0] == '-';
+            token += strlen(token) + 1;
+        }
+    }
+    return options;
+}
+#endif // CLI_VIEWS
+#endif // CLI_RESPONSE_FILES
+
+#ifdef CLI_CONFIG
+// Options of config files are overridden by environment variables (see CLI_RANK_ENV).
+#define CLI_RANK_CONFIG 0
+
+// Split a next option of a config file at `*line` into `option` and move `*line` to the line
+// after it. `number` counts lines. Returns false if no options are left.
+static bool cli_next_config_option(char** line, size_t* number, struct CliOption* option) {
+    for (char* start = *line; *start != '\0'; start = *line) {
+        char* end = start;
+        while (*end != '\0' && *end != '\n') {
+            end++;
+        }
+        *line = *end ? end + 1 : end;
+        ++*number;
+
+        while (start != end && cli_is_space(*start)) {
+            start++;
+        }
+        if (start == end || *start == '#') {
+            continue;
+        }
+        while (cli_is_space(end[-1])) {
+            end--;
+        }
+
+        char* equals = (char*)memchr(start, '=', end - start);
+        char* name_end = equals ? equals : end;
+        while (name_end != start && cli_is_space(name_end[-1])) {
+            name_end--;
+        }
+        option->dashes = 2;
+        if (start[0] == '-') {
+            option->dashes = start[1] == '-' ? 2 : 1;
+            start = start + option->dashes < name_end ? start + option->dashes : name_end;
+        }
+        option->name = start;
+        option->name_length = name_end - start;
+        option->value = NULL;
+        option->value_length = 0;
+        if (equals) {
+            char* value = equals + 1;
+            while (value != end && cli_is_space(*value)) {
+                value++;
+            }
+            option->value = value;
+            option->value_length = end - value;
+        }
+        option->converted_kind = CliConvertedNone;
+        return true;
+    }
+    return false;
+}
+
+enum CliError cli_load_config(Cli* cli, const char* path) {
+    char* data;
+    size_t size;
+    enum CliError error = cli_map_file(path, "a config file", 0, &data, &size);
+    if (error) {
+        return error;
+    }
+
+    // The file is checked before the layer is added, so that nothing is written to it on errors.
+    struct CliOption option;
+    size_t options = 0;
+    size_t number = 0;
+    char* line = data;
+    while (cli_next_config_option(&line, &number, &option)) {
+        if (option.name_length == 0) {
+            cli_printf_error(
+                "CLI error", "An option has no name in a config file ('%s', line %zu).", path,
+                number
+            );
+            munmap(data, size);
+            return CliErrorUser;
+        }
+        options++;
+    }
+    if (options == 0) {
+        munmap(data, size);
+        return CliErrorOk;
+    }
+
+    char* name_data;
+    struct CliLayer* layer = cli_add_layer(cli, CLI_RANK_CONFIG, options, 0, &name_data);
+    if (layer == NULL) {
+        munmap(data, size);
+        return CliErrorFatal;
+    }
+    layer->mapping = data;
+    layer->mapping_size = size;
+
+    // Names and values are terminated in place: a '\0' replaces '=', whitespace or a newline after
+    // them (or goes to the anonymous page after the file).
+    line = data;
+    while (cli_next_config_option(&line, &number, &layer->options[layer->length])) {
+        struct CliOption* added = &layer->options[layer->length++];
+        ((char*)added->name)[added->name_length] = '\0';
+        if (added->value) {
+            ((char*)added->value)[added->value_length] = '\0';
+        }
+    }
+    cli_finish_layer(cli);
+    return CliErrorOk;
+}
+#endif // CLI_CONFIG
+
+#ifdef CLI_HAS_WRITEV
+static bool cli_write_all(int fd, const char* data, size_t length) {
+    while (length) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+// Write `count` buffers of `iov` (that is changed) and return the number of written bytes or -1.
+//
+// writev(2) may write a part of them (e.g. to a pipe or if a signal interrupts it), so the rest
+// is retried.
+static int cli_writev_all(int fd, struct iovec* iov, int count) {
+    size_t total = 0;
+    while (count) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        total += (size_t)written;
+        // Skip written buffers, and the written part of the first unwritten one.
+        size_t left = (size_t)written;
+        while (count && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count) {
+            iov->iov_base = (char*)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return (int)total;
+}
+#endif // CLI_HAS_WRITEV
+
+// Lines of help text that are written by a single writev(2).
+#define CLI_HELP_LINES_PER_WRITE 64
+
+int cli_write_help(const CliHelpLine* styled, const CliHelpLine* plain, size_t count) {
+    bool is_styled = cli_get_style(1)->reset[0] != '\0'; // stdout
+    const CliHelpLine* lines = is_styled ? styled : plain;
+
+    // Earlier output of printf() should not appear after the text.
+    fflush(stdout);
+    int total = 0;
+    for (size_t start = 0; start < count; start += CLI_HELP_LINES_PER_WRITE) {
+        size_t end = count - start < CLI_HELP_LINES_PER_WRITE ? count
+                                                              : start + CLI_HELP_LINES_PER_WRITE;
+#ifdef CLI_HAS_WRITEV
+        struct iovec iov[CLI_HELP_LINES_PER_WRITE];
+        for (size_t i = start; i < end; i++) {
+            iov[i - start].iov_base = (void*)lines[i].text;
+            iov[i - start].iov_len = lines[i].length;
+        }
+        int written = cli_writev_all(1, iov, (int)(end - start));
+        if (written < 0) {
+            return -1;
+        }
+        total += written;
+#else
+        for (size_t i = start; i < end; i++) {
+            total += (int)fwrite(lines[i].text, 1, lines[i].length, stdout);
+        }
+#endif
+    }
+    return total;
+}
+
+#ifdef CLI_WRITER
+void cli_writer_init(CliWriter* writer, int fd, char* buffer, size_t size) {
+    writer->fd = fd;
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+}
+
+bool cli_writer_flush(CliWriter* writer) {
+    bool ok = cli_write_all(writer->fd, writer->buffer, writer->length);
+    writer->length = 0;
+    return ok;
+}
+
+static int cli_writer_vprintf(CliWriter* writer, const char* format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    size_t left = writer->size - writer->length;
+    int length = vsnprintf(writer->buffer + writer->length, left, format, copy);
+    va_end(copy);
+    if (length < 0 || (size_t)length < left) {
+        writer->length += length < 0 ? 0 : (size_t)length;
+        return length;
+    }
+
+    // The message does not fit (vsnprintf() has written a truncated one that is discarded).
+    cli_writer_flush(writer);
+    if ((size_t)length < writer->size) {
+        length = vsnprintf(writer->buffer, writer->size, format, args);
+        writer->length = (size_t)length;
+        return length;
+    }
+
+    // vdprintf() is not declared in strict ISO C modes, so a message larger than the whole buffer
+    // is formatted on the heap.
+    char* message = (char*)CLI_MALLOC((size_t)length + 1);
+    if (message == NULL) {
+        return -1;
+    }
+    length = vsnprintf(message, (size_t)length + 1, format, args);
+    if (!cli_write_all(writer->fd, message, (size_t)length)) {
+        length = -1;
+    }
+    CLI_FREE(message);
+    return length;
+}
+
+int cli_writer_printf(CliWriter* writer, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = cli_writer_vprintf(writer, format, args);
+    va_end(args);
+    return length;
+}
+
+static void cli_flush_writer_at_exit(void) {
+    if (cli_writer) {
+        cli_writer_flush(cli_writer);
+    }
+}
+
+void cli_set_writer(CliWriter* writer) {
+    static bool is_registered = false;
+    if (!is_registered) {
+        atexit(cli_flush_writer_at_exit);
+        is_registered = true;
+    }
+    if (cli_writer) {
+        cli_writer_flush(cli_writer);
+    }
+    cli_writer = writer;
+}
+#endif // CLI_WRITER
+
+#ifdef CLI_LOG_RING
+// A bounded MPSC ring of messages (Dmitry Vyukov's queue). A producer claims a
+// position with a CAS on `cli_log_head`, copies a message to the slot and
+// publishes it by advancing the sequence of the slot. The flusher drains
+// published slots in order and returns them to producers.
+struct CliLogSlot {
+    // A sequence number of the slot minus its index, so zero-initialized slots
+    // are ready for the first turn.
+    size_t sequence;
+    size_t length;
+    char data[CLI_LOG_RECORD_SIZE];
+};
+
+#define CLI_LOG_RING_MASK (CLI_LOG_RING_SIZE - 1)
+
+static struct CliLogSlot cli_log_slots[CLI_LOG_RING_SIZE];
+// Producers and the flusher update different cache lines.
+static size_t cli_log_head __attribute__((aligned(64)));
+static size_t cli_log_tail __attribute__((aligned(64)));
+static size_t cli_log_drops;
+static bool cli_log_is_flushing;
+static bool cli_log_is_registered;
+
+static void cli_flush_log_at_exit(void) {
+    cli_log_flush();
+}
+
+// Returns the length of the pushed message, 0 if a full ring drops it or -1 if the message is too
+// long for the ring.
+static int cli_log_push(const char* const* parts, const size_t* lengths, int count) {
+    size_t length = 0;
+    for (int i = 0; i < count; i++) {
+        length += lengths[i];
+    }
+    if (length > CLI_LOG_RECORD_SIZE) {
+        return -1;
+    }
+    if (!CLI_ATOMIC_LOAD(&cli_log_is_registered)) {
+        bool expected = false;
+        if (CLI_ATOMIC_CAS(&cli_log_is_registered, &expected, true)) {
+            atexit(cli_flush_log_at_exit);
+        }
+    }
+
+    size_t position = CLI_ATOMIC_LOAD(&cli_log_head);
+    struct CliLogSlot* slot;
+    for (;;) {
+        slot = &cli_log_slots[position & CLI_LOG_RING_MASK];
+        size_t sequence = CLI_ATOMIC_LOAD(&slot->sequence) + (position & CLI_LOG_RING_MASK);
+        if (sequence == position) {
+            if (CLI_ATOMIC_CAS(&cli_log_head, &position, position + 1)) {
+                break;
+            }
+        } else if ((ptrdiff_t)(sequence - position) < 0) {
+            // The slot is not drained yet, so the ring is full.
+            CLI_ATOMIC_ADD(&cli_log_drops, 1);
+            return 0;
+        } else {
+            position = CLI_ATOMIC_LOAD(&cli_log_head);
+        }
+    }
+
+    char* data = slot->data;
+    for (int i = 0; i < count; i++) {
+        memcpy(data, parts[i], lengths[i]);
+        data += lengths[i];
+    }
+    slot->length = length;
+    CLI_ATOMIC_STORE(&slot->sequence, position + 1 - (position & CLI_LOG_RING_MASK));
+    return (int)length;
+}
+
+size_t cli_log_flush(void) {
+    bool expected = false;
+    if (!CLI_ATOMIC_CAS(&cli_log_is_flushing, &expected, true)) {
+        return 0;
+    }
+
+    // Only the flusher uses the buffer and `cli_log_tail`.
+    static char buffer[64 * 1024 > CLI_LOG_RECORD_SIZE ? 64 * 1024 : CLI_LOG_RECORD_SIZE];
+    size_t length = 0;
+    size_t position = cli_log_tail;
+    for (;; position++) {
+        struct CliLogSlot* slot = &cli_log_slots[position & CLI_LOG_RING_MASK];
+        size_t index = position & CLI_LOG_RING_MASK;
+        if (CLI_ATOMIC_LOAD(&slot->sequence) + index != position + 1) {
+            break; // Empty or not published yet
+        }
+        if (slot->length > sizeof(buffer) - length) {
+            cli_write_all(STDERR_FILENO, buffer, length);
+            length = 0;
+        }
+        memcpy(buffer + length, slot->data, slot->length);
+        length += slot->length;
+        CLI_ATOMIC_STORE(&slot->sequence, position + CLI_LOG_RING_SIZE - index);
+    }
+    cli_write_all(STDERR_FILENO, buffer, length);
+
+    size_t count = position - cli_log_tail;
+    cli_log_tail = position;
+    CLI_ATOMIC_STORE(&cli_log_is_flushing, false);
+    return count;
+}
+
+size_t cli_log_dropped(void) {
+    return CLI_ATOMIC_LOAD_RELAXED(&cli_log_drops);
+}
+#endif // CLI_LOG_RING
+
+// The style of messages of printing macros.
+static const CliStyle* cli_message_style(void) {
+#ifdef CLI_WRITER
+    if (cli_writer) {
+        return cli_get_style(cli_writer->fd);
+    }
+#endif
+    return cli_get_style(2); // stderr
+}
+
+// Write `count` parts with a single writev(2) or copy them to the current writer.
+static int cli_write_parts(const char* const* parts, const size_t* lengths, int count) {
+#ifdef CLI_WRITER
+    int fd = STDERR_FILENO;
+    if (cli_writer) {
+        size_t length = 0;
+        for (int i = 0; i < count; i++) {
+            length += lengths[i];
+        }
+        if (length > cli_writer->size - cli_writer->length) {
+            cli_writer_flush(cli_writer);
+        }
+        if (length <= cli_writer->size) {
+            for (int i = 0; i < count; i++) {
+                memcpy(cli_writer->buffer + cli_writer->length, parts[i], lengths[i]);
+                cli_writer->length += lengths[i];
+            }
+            return (int)length;
+        }
+        fd = cli_writer->fd;
+    }
+#elif defined(CLI_HAS_WRITEV)
+    int fd = STDERR_FILENO;
+#endif // CLI_WRITER
+
+#ifdef CLI_HAS_WRITEV
+    struct iovec iov[4];
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = (void*)parts[i];
+        iov[i].iov_len = lengths[i];
+    }
+    return cli_writev_all(fd, iov, count);
+#else
+    size_t length = 0;
+    for (int i = 0; i < count; i++) {
+        length += fwrite(parts[i], 1, lengths[i], stderr);
+    }
+    return (int)length;
+#endif // CLI_HAS_WRITEV
+}
+
+// Push a message to the log ring (if enabled) or write it.
+static int cli_emit_parts(const char* const* parts, const size_t* lengths, int count) {
+#ifdef CLI_LOG_RING
+    int length = cli_log_push(parts, lengths, count);
+    if (length >= 0) {
+        return length;
+    }
+#endif
+    return cli_write_parts(parts, lengths, count);
+}
+
+int cli_write_message_(
+    enum CliLevel level, const char* title, size_t title_length, const char* msg, size_t msg_length
+) {
+    const CliStyle* style = cli_message_style();
+    const char* parts[4] = { style->prefix[level], title, style->title_end[level], msg };
+    size_t lengths[4] = {
+        style->prefix_length[level], title_length, style->title_end_length[level], msg_length
+    };
+    return cli_emit_parts(parts, lengths, 4);
+}
+
+// Messages of printf variants are formatted on the stack if they are shorter than this.
+#define CLI_MESSAGE_BUFFER_SIZE 1024
+
+int cli_printf_message_(
+    enum CliLevel level, const char* title, size_t title_length, const char* format, ...
+) {
+    const CliStyle* style = cli_message_style();
+    const char* parts[3] = { style->prefix[level], title, style->title_end[level] };
+    size_t lengths[3] = {
+        style->prefix_length[level], title_length, style->title_end_length[level]
+    };
+
+    va_list args;
+    char buffer[CLI_MESSAGE_BUFFER_SIZE];
+    size_t length = lengths[0] + lengths[1] + lengths[2];
+    if (length < sizeof(buffer)) {
+        char* end = buffer;
+        for (int i = 0; i < 3; i++) {
+            memcpy(end, parts[i], lengths[i]);
+            end += lengths[i];
+        }
+        va_start(args, format);
+        int msg_length = vsnprintf(end, sizeof(buffer) - length, format, args);
+        va_end(args);
+        if (msg_length >= 0 && (size_t)msg_length < sizeof(buffer) - length) {
+            const char* message = buffer;
+            length += (size_t)msg_length;
+            return cli_emit_parts(&message, &length, 1);
+        }
+    }
+
+    // A long message is written after its prefix.
+    int written = cli_write_parts(parts, lengths, 3);
+    va_start(args, format);
+#ifdef CLI_WRITER
+    if (cli_writer) {
+        written += cli_writer_vprintf(cli_writer, format, args);
+        va_end(args);
+        return written;
+    }
+#endif
+    written += vfprintf(stderr, format, args);
+    va_end(args);
+    return written;
+}
+
+#ifdef CLI_HAS_WRITEV
+// A message of cli_printf_message_safe_() that is written when the buffer is full.
+struct CliSafeMessage {
+    char buffer[CLI_MESSAGE_BUFFER_SIZE];
+    size_t length;
+    size_t written;
+};
+
+static void cli_safe_flush(struct CliSafeMessage* message) {
+    if (cli_write_all(STDERR_FILENO, message->buffer, message->length)) {
+        message->written += message->length;
+    }
+    message->length = 0;
+}
+
+static void cli_safe_append(struct CliSafeMessage* message, const char* data, size_t length) {
+    while (length) {
+        if (message->length == sizeof(message->buffer)) {
+            cli_safe_flush(message);
+        }
+        size_t left = sizeof(message->buffer) - message->length;
+        size_t count = length < left ? length : left;
+        memcpy(message->buffer + message->length, data, count);
+        message->length += count;
+        data += count;
+        length -= count;
+    }
+}
+
+static void
+cli_safe_append_number(struct CliSafeMessage* message, unsigned long long value, unsigned base) {
+    char digits[3 * sizeof(value)];
+    char* start = digits + sizeof(digits);
+    do {
+        *--start = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value);
+    cli_safe_append(message, start, digits + sizeof(digits) - start);
+}
+
+int cli_printf_message_safe_(
+    enum CliLevel level, const char* title, size_t title_length, const char* format, ...
+) {
+    // A signal handler should not change `errno` of the interrupted code.
+    int saved_errno = errno;
+    const CliStyle* style = cli_get_style(2); // stderr
+    struct CliSafeMessage message;
+    message.length = 0;
+    message.written = 0;
+    cli_safe_append(&message, style->prefix[level], style->prefix_length[level]);
+    cli_safe_append(&message, title, title_length);
+    cli_safe_append(&message, style->title_end[level], style->title_end_length[level]);
+
+    va_list args;
+    va_start(args, format);
+    for (const char* f = format; *f != '\0'; f++) {
+        if (*f != '%') {
+            const char* start = f;
+            while (f[1] != '\0' && f[1] != '%') {
+                f++;
+            }
+            cli_safe_append(&message, start, f + 1 - start);
+            continue;
+        }
+
+        const char* conversion = f;
+        int longs = 0;
+        bool is_size = false;
+        for (f++; *f == 'l'; f++) {
+            longs++;
+        }
+        if (*f == 'z') {
+            is_size = true;
+            f++;
+        }
+        switch (*f) {
+        case 's': {
+            const char* string = va_arg(args, const char*);
+            string = string ? string : "(null)";
+            cli_safe_append(&message, string, strlen(string));
+            break;
+        }
+        case 'c': {
+            char c = (char)va_arg(args, int);
+            cli_safe_append(&message, &c, 1);
+            break;
+        }
+        case 'd':
+        case 'i': {
+            long long value = is_size ? (long long)va_arg(args, ptrdiff_t)
+                            : longs > 1 ? va_arg(args, long long)
+                            : longs ? (long long)va_arg(args, long)
+                                    : (long long)va_arg(args, int);
+            if (value < 0) {
+                cli_safe_append(&message, "-", 1);
+            }
+            cli_safe_append_number(
+                &message, value < 0 ? 0 - (unsigned long long)value : (unsigned long long)value, 10
+            );
+            break;
+        }
+        case 'u':
+        case 'x': {
+            unsigned long long value = is_size ? (unsigned long long)va_arg(args, size_t)
+                                     : longs > 1 ? va_arg(args, unsigned long long)
+                                     : longs ? (unsigned long long)va_arg(args, unsigned long)
+                                             : (unsigned long long)va_arg(args, unsigned int);
+            cli_safe_append_number(&message, value, *f == 'u' ? 10 : 16);
+            break;
+        }
+        case 'p':
+            cli_safe_append(&message, "0x", 2);
+            cli_safe_append_number(&message, (size_t)va_arg(args, void*), 16);
+            break;
+        case '\0':
+            f--; // A trailing '%' is ignored.
+            break;
+        case '%':
+            cli_safe_append(&message, f, 1);
+            break;
+        default: {
+            // The type of an argument of an unsupported conversion (e.g. %5d or %f) is unknown,
+            // so next arguments cannot be read. The rest of the format is written as is.
+            size_t rest = strlen(conversion);
+            cli_safe_append(&message, conversion, rest);
+            f = conversion + rest - 1;
+            break;
+        }
+        }
+    }
+    va_end(args);
+
+    cli_safe_flush(&message);
+    errno = saved_errno;
+    return (int)message.written;
+}
+#endif // CLI_HAS_WRITEV
+
+#ifndef CLI_NOHEAP
+static void* cli_default_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    return CLI_MALLOC(size);
+}
+
+static void* cli_default_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return CLI_REALLOC(ptr, new_size);
+}
+
+static void cli_default_free(void* ctx, void* ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    CLI_FREE(ptr);
+}
+
+CliAllocator cli_default_allocator(void) {
+    CliAllocator allocator;
+    allocator.ctx = NULL;
+    allocator.alloc = cli_default_alloc;
+    allocator.realloc = cli_default_realloc;
+    allocator.free = cli_default_free;
+    return allocator;
+}
+
+// Allocations of an arena are aligned for any type that cli.h stores.
+#define CLI_ARENA_ALIGNMENT (2 * sizeof(void*))
+
+static void* cli_arena_alloc(void* ctx, size_t size) {
+    CliArena* arena = (CliArena*)ctx;
+    // The buffer itself may be unaligned (e.g. `char buffer[4096]`), so the address is aligned.
+    uintptr_t address = (uintptr_t)(arena->data + arena->used);
+    size_t padding = (size_t)(-address & (CLI_ARENA_ALIGNMENT - 1));
+    size_t start = arena->used + padding;
+    if (padding > arena->size - arena->used || size > arena->size - start) {
+        return NULL;
+    }
+    arena->used = start + size;
+    return arena->data + start;
+}
+
+static void* cli_arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    CliArena* arena = (CliArena*)ctx;
+    // The last allocation can grow in place.
+    if (ptr && (char*)ptr + old_size == arena->data + arena->used) {
+        size_t start = (char*)ptr - arena->data;
+        if (new_size > arena->size - start) {
+            return NULL;
+        }
+        arena->used = start + new_size;
+        return ptr;
+    }
+
+    void* result = cli_arena_alloc(ctx, new_size);
+    if (result && ptr) {
+        memcpy(result, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return result;
+}
+
+static void cli_arena_free(void* ctx, void* ptr, size_t size) {
+    (void)ctx;
+    (void)ptr;
+    (void)size;
+}
+
+void cli_arena_init(CliArena* arena, void* buffer, size_t size) {
+    arena->data = (char*)buffer;
+    arena->size = size;
+    arena->used = 0;
+}
+
+CliAllocator cli_arena_allocator(CliArena* arena) {
+    CliAllocator allocator;
+    allocator.ctx = arena;
+    allocator.alloc = cli_arena_alloc;
+    allocator.realloc = cli_arena_realloc;
+    allocator.free = cli_arena_free;
+    return allocator;
+}
+
+void cli_arena_reset(CliArena* arena) {
+    arena->used = 0;
+}
+#endif // CLI_NOHEAP
+
+void cli_parser_init(CliParser* parser, int argc, char** argv) {
+    memset(parser, 0, sizeof(*parser));
+    parser->argc = argc;
+    parser->argv = argv;
+    parser->execfile = cli_pop_argv(&parser->argc, &parser->argv);
+}
+
+bool cli_parser_feed(CliParser* parser, const char* arg, struct CliToken* token) {
+    if (parser->error) {
+        return false;
+    }
+
+    token->arg = arg;
+    if (arg[0] == '-') {
+        if (arg[1] == '-' && arg[2] == '\0') {
+            if (parser->last_arg) {
+                if (!parser->is_quiet) {
+                    cli_printf_error(
+                        "CLI error",
+                        "Double dash ('%s') cannot be specified after the positional argument "
+                        "('%s').",
+                        arg, parser->last_arg
+                    );
+                }
+                parser->error = CliErrorUser;
+                return false;
+            }
+            parser->is_cmd_option = true;
+            return false;
+        }
+
+        if (parser->is_cmd_option) {
+            parser->has_cmd_options = true;
+            token->kind = CliTokenCmdOption;
+        } else {
+            token->kind = CliTokenProgramOption;
+        }
+        return true;
+    }
+
+    if (parser->has_cmd_options) {
+        if (!parser->is_quiet) {
+            cli_printf_error(
+                "CLI error",
+                "Positional arguments ('%s') should be specified prior to command options.", arg
+            );
+        }
+        parser->error = CliErrorUser;
+        return false;
+    }
+    parser->last_arg = arg;
+    parser->is_cmd_option = true;
+    token->kind = CliTokenArg;
+    return true;
+}
+
+bool cli_parser_next(CliParser* parser, struct CliToken* token) {
+    while (parser->argc && !parser->error) {
+        if (cli_parser_feed(parser, cli_pop_argv(&parser->argc, &parser->argv), token)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef CLI_COMPACT
+// Check that offsets of `argc` arguments from the lowest of them fit into `CliItem` and save the
+// lowest one to `base`. On Linux, arguments of main() are stored next to each other.
+static bool cli_find_base(int argc, char** argv, const char** base, bool is_quiet) {
+    uintptr_t low = UINTPTR_MAX;
+    uintptr_t high = 0;
+    for (int i = 0; i < argc; i++) {
+        uintptr_t arg = (uintptr_t)argv[i];
+        low = arg < low ? arg : low;
+        high = arg > high ? arg : high;
+    }
+    if (argc && high - low > (CliItem)-1) {
+        if (!is_quiet) {
+            cli_print_error("CLI error", "Arguments are too far from each other for CLI_COMPACT.");
+        }
+        return false;
+    }
+    *base = (const char*)low;
+    return true;
+}
+
+static void cli_set_base(Cli* cli, const char* base) {
+    cli->args.base = base;
+    cli->cmd_options.base = base;
+    cli->program_options.base = base;
+}
+#endif // CLI_COMPACT
+
+// Check that `CliArray.length` (and offsets of options in the index) can count `items`.
+static bool cli_fits_length(size_t items, bool is_quiet) {
+    bool fits = items <= (CLI_SIZE_T)-1;
+#ifdef CLI_INDEX
+    fits = fits && items < (unsigned int)-1;
+#endif
+    if (!fits && !is_quiet) {
+        cli_printf_error("CLI error", "Too many arguments (%zu).", items);
+    }
+    return fits;
+}
+
+#ifndef CLI_NOHEAP
+// Cursors into the block of `Cli` (see cli_prepare_block()).
+struct CliBlock {
+    CliItem* next_unused;
+#ifdef CLI_VIEWS
+    struct CliOption* next_option;
+#endif
+#ifdef CLI_INDEX
+    unsigned int* index;
+    size_t index_capacity;
+#endif
+};
+
+/*
+ * Make the block of `cli` large enough for `items` arguments with `options`
+ * options (ignored without CLI_VIEWS) and prepare arrays for appending.
+ *
+ * Every argument is stored in exactly one array, so `items` are enough for all
+ * of them. Options and the index are stored right after the arrays:
+ *     [arrays][CliArray.options][Cli.index]
+ * Returns false if memory cannot be allocated (an error is printed unless
+ * `is_quiet` is true).
+ */
+static bool cli_prepare_block(
+    Cli* cli, size_t items, size_t options, struct CliBlock* block, bool is_quiet
+) {
+    // `options` never exceed `items`, and each item takes less than 128 bytes of the block (with
+    // an option and up to 4 slots of the index), so the size cannot overflow.
+    if (!cli_fits_length(items, is_quiet) || items > (size_t)-1 / 128) {
+        return false;
+    }
+#ifdef CLI_COMPACT
+    // Options that follow items should be aligned.
+    items += items & 1;
+#endif
+    size_t block_size = items * sizeof(CliItem);
+#ifdef CLI_VIEWS
+    block_size += options * sizeof(struct CliOption);
+#else
+    (void)options;
+#endif
+#ifdef CLI_INDEX
+    size_t index_capacity = cli_index_capacity(options);
+    block_size += index_capacity * sizeof(unsigned int);
+#endif
+    if (block_size > cli->block_size) {
+        // The contents are not needed, so the block is replaced instead of being reallocated.
+        if (cli->block) {
+            cli_release(cli, cli->block, cli->block_size);
+        }
+        cli->block = cli_allocate(cli, block_size);
+        cli->block_size = cli->block ? block_size : 0;
+    }
+    if (cli->block == NULL) {
+        if (!is_quiet) {
+            cli_print_error("Memory error", "Unable to allocate memory for CLI arguments.");
+        }
+        return false;
+    }
+
+    block->next_unused = (CliItem*)cli->block;
+    cli_da_init(cli->args, block->next_unused);
+    cli_da_init(cli->cmd_options, block->next_unused);
+    cli_da_init(cli->program_options, block->next_unused);
+#ifdef CLI_SHORT_FLAGS
+    memset(cli->short_flags, 0, sizeof(cli->short_flags));
+#endif
+#ifdef CLI_VIEWS
+    block->next_option = (struct CliOption*)(block->next_unused + items);
+    cli->args.options = NULL;
+    cli->cmd_options.options = block->next_option;
+    cli->program_options.options = block->next_option;
+#endif
+#ifdef CLI_INDEX
+    block->index = (unsigned int*)(block->next_option + options);
+    block->index_capacity = index_capacity;
+    memset(block->index, 0, index_capacity * sizeof(unsigned int));
+    // The index is not built yet, so cli_free() should not see it on errors.
+    cli->index = NULL;
+#endif
+    return true;
+}
+
+// Append an argument classified by cli_parser_feed() to its array.
+static void cli_store_token(Cli* cli, struct CliBlock* block, const struct CliToken* token) {
+    CliItem* next_unused = block->next_unused;
+    if (token->kind == CliTokenArg) {
+        cli_da_append(cli->args, token->arg);
+    } else {
+        struct CliArray* option_array
+            = token->kind == CliTokenCmdOption ? &cli->cmd_options : &cli->program_options;
+        cli_da_append(*option_array, token->arg);
+#ifdef CLI_SHORT_FLAGS
+        if (token->kind == CliTokenProgramOption) {
+            cli_add_short_flags(cli, token->arg);
+        }
+#endif
+#ifdef CLI_VIEWS
+        if (option_array->length == 1) {
+            option_array->options = block->next_option;
+        }
+        cli_split_option(token->arg, block->next_option++);
+#endif
+    }
+    block->next_unused = next_unused;
+}
+
+// Finish arrays after all arguments are stored.
+static void cli_finish_block(Cli* cli, struct CliBlock* block) {
+#ifdef CLI_INDEX
+    cli->index = block->index;
+    cli->index_mask = (unsigned int)block->index_capacity - 1;
+    cli_index_build(cli);
+#else
+    (void)cli;
+    (void)block;
+#endif
+}
+#endif // CLI_NOHEAP
+
+#ifdef CLI_NOHEAP
+enum CliError cli_parse(int argc, char** argv, Cli* cli) {
+#else
+// Parse into the block of `cli` or a new one. If `keeps_block` is false, the block is released on
+// errors (see cli_parse()).
+static enum CliError cli_parse_block(int argc, char** argv, Cli* cli, bool keeps_block);
+
+enum CliError cli_parse(int argc, char** argv, Cli* cli) {
+    return cli_parse_ex(argc, argv, cli, NULL);
+}
+
+enum CliError cli_parse_ex(int argc, char** argv, Cli* cli, const CliAllocator* allocator) {
+    cli->allocator = allocator ? *allocator : cli_default_allocator();
+    cli->block = NULL;
+    cli->block_size = 0;
+#ifdef CLI_LAYERS
+    cli->layers = NULL;
+#endif
+#ifdef CLI_STREAM
+    cli->chunks = NULL;
+#endif
+#ifdef CLI_STATS
+    memset(&cli->stats, 0, sizeof(cli->stats));
+#endif
+    return cli_parse_block(argc, argv, cli, false);
+}
+
+enum CliError cli_reparse(int argc, char** argv, Cli* cli) {
+    if (cli->allocator.alloc == NULL) {
+        cli->allocator = cli_default_allocator();
+    }
+    cli_reset(cli);
+#ifdef CLI_STATS
+    // The kept block is still counted.
+    size_t bytes = cli->stats.bytes;
+    memset(&cli->stats, 0, sizeof(cli->stats));
+    cli->stats.bytes = bytes;
+    cli->stats.peak_bytes = bytes;
+#endif
+    return cli_parse_block(argc, argv, cli, true);
+}
+
+static enum CliError cli_parse_block(int argc, char** argv, Cli* cli, bool keeps_block) {
+#endif // CLI_NOHEAP
+#ifdef CLI_STATS
+    unsigned long long start_ns = cli_now_ns();
+#endif
+    CliParser parser;
+    cli_parser_init(&parser, argc, argv);
+    argc = parser.argc;
+    argv = parser.argv;
+
+    if (argc > 0) {
+        cli->execfile = parser.execfile;
+#ifdef CLI_NOHEAP
+        if (!cli_fits_length((size_t)argc, false)) {
+            return CliErrorFatal;
+        }
+        cli_da_init(cli->args, NULL);
+        cli_da_init(cli->cmd_options, NULL);
+        cli_da_init(cli->program_options, NULL);
+#ifdef CLI_SHORT_FLAGS
+        memset(cli->short_flags, 0, sizeof(cli->short_flags));
+#endif
+#else
+        size_t items = argc;
+#ifdef CLI_RESPONSE_FILES
+        // Response files are tokenized beforehand, so that their arguments are counted too.
+        enum CliError error = cli_map_response_files(argc, argv, cli, &items);
+        if (error) {
+            return error;
+        }
+        // Empty response files may leave no items, but arrays still need a block to point to.
+        if (items == 0) {
+            items = 1;
+        }
+#endif
+        size_t options = 0;
+#ifdef CLI_VIEWS
+        options = cli_count_options(argc, argv);
+#ifdef CLI_RESPONSE_FILES
+        options += cli_count_response_file_options(cli->mappings);
+#endif
+#endif
+#ifdef CLI_COMPACT
+        const char* base;
+        if (!cli_find_base(argc, argv, &base, false)) {
+            return CliErrorFatal;
+        }
+#endif
+        struct CliBlock block;
+        if (!cli_prepare_block(cli, items, options, &block, false)) {
+#ifdef CLI_RESPONSE_FILES
+            cli_unmap_response_files(cli);
+#endif
+            return CliErrorFatal;
+        }
+#ifdef CLI_COMPACT
+        cli_set_base(cli, base);
+#endif
+#endif // CLI_NOHEAP
+
+        const char* arg;
+        struct CliToken token;
+#ifdef CLI_RESPONSE_FILES
+        struct CliMapping* mapping = cli->mappings;
+        const char* response_token = NULL;
+        size_t tokens_left = 0;
+        while (parser.argc || tokens_left) {
+            if (tokens_left) {
+                arg = response_token;
+                response_token += strlen(response_token) + 1;
+                tokens_left--;
+            } else {
+                arg = cli_pop_argv(&parser.argc, &parser.argv);
+                if (cli_is_response_file(arg)) {
+                    response_token = mapping->tokens;
+                    tokens_left = mapping->token_count;
+                    mapping = mapping->next;
+                    continue;
+                }
+            }
+#else
+        while (parser.argc) {
+            arg = cli_pop_argv(&parser.argc, &parser.argv);
+#endif // CLI_RESPONSE_FILES
+            if (!cli_parser_feed(&parser, arg, &token)) {
+                if (parser.error) {
+#ifdef CLI_NOHEAP
+                    cli_free(cli);
+#else
+                    keeps_block ? cli_reset(cli) : cli_free(cli);
+#endif
+                    return parser.error;
+                }
+                continue;
+            }
+
+#ifdef CLI_NOHEAP
+            struct CliArray* array = token.kind == CliTokenArg ? &cli->args
+                : token.kind == CliTokenCmdOption              ? &cli->cmd_options
+                                                               : &cli->program_options;
+            cli_da_append(*array, arg);
+#ifdef CLI_SHORT_FLAGS
+            if (token.kind == CliTokenProgramOption) {
+                cli_add_short_flags(cli, arg);
+            }
+#endif
+#else
+            cli_store_token(cli, &block, &token);
+#endif
+        }
+#ifndef CLI_NOHEAP
+        cli_finish_block(cli, &block);
+#endif
+    } else {
+#ifdef CLI_NOHEAP
+        memset(cli, 0, sizeof(*cli));
+#else
+        Cli kept = *cli;
+        memset(cli, 0, sizeof(*cli));
+        cli->allocator = kept.allocator;
+        cli->block = kept.block;
+        cli->block_size = kept.block_size;
+#ifdef CLI_STATS
+        cli->stats = kept.stats;
+#endif
+#endif
+        cli->execfile = parser.execfile;
+    }
+#ifdef CLI_STATS
+    cli->stats.parse_ns = cli_now_ns() - start_ns;
+#endif
+    return CliErrorOk;
+}
+
+#ifndef CLI_NOHEAP
+// Parse `line` into a new block of `cli->allocator` (see cli_parse_string()).
+static enum CliError cli_parse_line(char* line, Cli* cli, bool is_quiet) {
+#ifdef CLI_STATS
+    unsigned long long start_ns = cli_now_ns();
+#endif
+    // The line is tokenized in place first, so tokens are stored one after another at its start
+    // and the block is sized exactly by their count (like by `argc` in cli_parse()).
+    char* read = line;
+    char* write = line;
+    char* arg;
+    size_t items = 0;
+    while (true) {
+        if (cli_next_token(&read, &write, &arg)) {
+            if (!is_quiet) {
+                cli_print_error("CLI error", "A quote is not closed in the command line.");
+            }
+            cli_free(cli);
+            return CliErrorUser;
+        }
+        if (arg == NULL) {
+            break;
+        }
+        items++;
+    }
+    // An empty line still gets a block for arrays to point to.
+    if (items == 0) {
+        items = 1;
+    }
+#ifdef CLI_COMPACT
+    char* bounds[] = { line, write };
+    const char* base;
+    if (!cli_find_base(2, bounds, &base, is_quiet)) {
+        return CliErrorFatal;
+    }
+#endif
+    struct CliBlock block;
+    if (!cli_prepare_block(cli, items, items, &block, is_quiet)) {
+        return CliErrorFatal;
+    }
+#ifdef CLI_COMPACT
+    cli_set_base(cli, base);
+#endif
+
+    CliParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.is_quiet = is_quiet;
+    struct CliToken token;
+    for (char* next = line; next != write;) {
+        arg = next;
+        next += strlen(arg) + 1;
+        if (cli_parser_feed(&parser, arg, &token)) {
+            cli_store_token(cli, &block, &token);
+        } else if (parser.error) {
+            cli_free(cli);
+            return parser.error;
+        }
+    }
+    cli_finish_block(cli, &block);
+#ifdef CLI_STATS
+    cli->stats.parse_ns = cli_now_ns() - start_ns;
+#endif
+    return CliErrorOk;
+}
+
+enum CliError cli_parse_string(char* line, Cli* cli) {
+    memset(cli, 0, sizeof(*cli));
+    cli->allocator = cli_default_allocator();
+    return cli_parse_line(line, cli, false);
+}
+
+#ifdef CLI_STREAM
+// A chunk of arguments read by cli_read_args(). Arguments follow the header.
+struct CliChunk {
+    struct CliChunk* next;
+    size_t size;
+    size_t used;
+};
+
+// Free chunks of `cli` until `last` (e.g. the chunks added by a failed cli_read_args()).
+static void cli_free_chunks(Cli* cli, struct CliChunk* last) {
+    while (cli->chunks != last) {
+        struct CliChunk* next = cli->chunks->next;
+        cli_release(cli, cli->chunks, cli->chunks->size);
+        cli->chunks = next;
+    }
+}
+
+enum CliError cli_stream_args(
+    int fd, char* buffer, size_t size, bool (*callback)(void* ctx, const char* arg, size_t length),
+    void* ctx
+) {
+    // [0, length) of `buffer` is a beginning of an argument that has no '\0' yet.
+    size_t length = 0;
+    while (true) {
+        // One byte is always left for the '\0' of a last argument.
+        if (length + 1 >= size) {
+            cli_printf_error("CLI error", "An argument is longer than the buffer (%zu bytes).", size);
+            return CliErrorUser;
+        }
+        ssize_t count = read(fd, buffer + length, size - 1 - length);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cli_printf_error("CLI error", "Unable to read arguments (%s).", strerror(errno));
+            return CliErrorFatal;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        // Only new bytes are searched: the beginning has no '\0'.
+        char* arg = buffer;
+        char* end = buffer + length + count;
+        char* nul = (char*)memchr(buffer + length, '\0', (size_t)count);
+        while (nul) {
+            if (!callback(ctx, arg, (size_t)(nul - arg))) {
+                return CliErrorUser;
+            }
+            arg = nul + 1;
+            nul = (char*)memchr(arg, '\0', (size_t)(end - arg));
+        }
+        length = (size_t)(end - arg);
+        memmove(buffer, arg, length);
+    }
+
+    if (length) {
+        buffer[length] = '\0';
+        if (!callback(ctx, buffer, length)) {
+            return CliErrorUser;
+        }
+    }
+    return CliErrorOk;
+}
+
+// Arguments collected by cli_read_args() before they are added to the block.
+struct CliStreamed {
+    Cli* cli;
+    const char** args;
+    size_t length;
+    size_t capacity;
+    bool is_failed;
+};
+
+// Copy `arg` to a chunk of `streamed->cli` and remember it (see cli_stream_args()).
+static bool cli_collect_arg(void* ctx, const char* arg, size_t length) {
+    struct CliStreamed* streamed = (struct CliStreamed*)ctx;
+    Cli* cli = streamed->cli;
+
+    struct CliChunk* chunk = cli->chunks;
+    if (chunk == NULL || chunk->size - chunk->used <= length) {
+        // Arguments never exceed the buffer, so a chunk of its size fits any of them.
+        size_t size = sizeof(struct CliChunk) + CLI_STREAM_BUFFER_SIZE;
+        chunk = (struct CliChunk*)cli_allocate(cli, size);
+        if (chunk == NULL) {
+            streamed->is_failed = true;
+            return false;
+        }
+        chunk->next = cli->chunks;
+        chunk->size = size;
+        chunk->used = sizeof(*chunk);
+        cli->chunks = chunk;
+    }
+    char* copy = (char*)chunk + chunk->used;
+    memcpy(copy, arg, length + 1);
+    chunk->used += length + 1;
+
+    if (streamed->length == streamed->capacity) {
+        size_t capacity = streamed->capacity ? streamed->capacity * 2 : 256;
+        const char** args = NULL;
+        if (capacity <= (size_t)-1 / sizeof(const char*)) {
+            args = (const char**)cli_reallocate(
+                cli, (void*)streamed->args, streamed->capacity * sizeof(const char*),
+                capacity * sizeof(const char*)
+            );
+        }
+        if (args == NULL) {
+            streamed->is_failed = true;
+            return false;
+        }
+        streamed->args = args;
+        streamed->capacity = capacity;
+    }
+    streamed->args[streamed->length++] = copy;
+    return true;
+}
+
+// Store arguments of `cli` and `streamed` arguments after its positional arguments in a new block.
+static enum CliError cli_append_args(Cli* cli, const char** streamed, size_t count) {
+    Cli old = *cli;
+    size_t items = old.program_options.length + old.args.length + count + old.cmd_options.length;
+    size_t options = old.program_options.length + old.cmd_options.length;
+#ifdef CLI_LAYERS
+    // The index of the block also covers layers.
+    for (const struct CliLayer* layer = old.layers; layer; layer = layer->next) {
+        options += layer->length;
+    }
+#endif
+
+    // The old block is still read, so a new one is allocated instead of being reused.
+    cli->block = NULL;
+    cli->block_size = 0;
+    struct CliBlock block;
+    if (items < count || !cli_prepare_block(cli, items, options, &block, false)) {
+        *cli = old;
+        return CliErrorFatal;
+    }
+
+    const struct CliArray* arrays[] = { &old.program_options, &old.args, &old.cmd_options };
+    const enum CliTokenKind kinds[] = { CliTokenProgramOption, CliTokenArg, CliTokenCmdOption };
+    for (size_t i = 0; i < 3; i++) {
+        struct CliToken token = { kinds[i], NULL };
+        for (size_t j = 0; j < arrays[i]->length; j++) {
+            token.arg = arrays[i]->data[j];
+            cli_store_token(cli, &block, &token);
+        }
+        if (kinds[i] == CliTokenArg) {
+            for (size_t j = 0; j < count; j++) {
+                token.arg = streamed[j];
+                cli_store_token(cli, &block, &token);
+            }
+        }
+    }
+    cli_finish_block(cli, &block);
+
+    if (old.block) {
+        cli_release(cli, old.block, old.block_size);
+    }
+    return CliErrorOk;
+}
+
+enum CliError cli_read_args(Cli* cli, int fd) {
+    if (cli->allocator.alloc == NULL) {
+        cli->allocator = cli_default_allocator();
+    }
+    char* buffer = (char*)cli_allocate(cli, CLI_STREAM_BUFFER_SIZE);
+    if (buffer == NULL) {
+        cli_print_error("Memory error", "Unable to allocate memory for CLI arguments.");
+        return CliErrorFatal;
+    }
+
+    struct CliChunk* last = cli->chunks;
+    struct CliStreamed streamed;
+    memset(&streamed, 0, sizeof(streamed));
+    streamed.cli = cli;
+    enum CliError error
+        = cli_stream_args(fd, buffer, CLI_STREAM_BUFFER_SIZE, cli_collect_arg, &streamed);
+    cli_release(cli, buffer, CLI_STREAM_BUFFER_SIZE);
+    if (streamed.is_failed) {
+        cli_print_error("Memory error", "Unable to allocate memory for CLI arguments.");
+        error = CliErrorFatal;
+    }
+    if (!error && streamed.length) {
+        error = cli_append_args(cli, streamed.args, streamed.length);
+    }
+    if (error) {
+        cli_free_chunks(cli, last);
+    }
+    if (streamed.args) {
+        cli_release(cli, (void*)streamed.args, streamed.capacity * sizeof(const char*));
+    }
+    return error;
+}
+#endif // CLI_STREAM
+
+#ifdef CLI_BATCH
+// Lines taken by a thread at once.
+#define CLI_BATCH_CHUNK 64
+// A minimum size of a slab of a worker.
+#define CLI_BATCH_SLAB_SIZE (64 * 1024)
+
+// A chunk of memory of an arena of a worker. The memory follows the header.
+struct CliSlab {
+    struct CliSlab* next;
+};
+
+#define CLI_SLAB_HEADER                                                               \
+    ((sizeof(struct CliSlab) + CLI_ARENA_ALIGNMENT - 1) & ~(CLI_ARENA_ALIGNMENT - 1))
+
+// Arguments of cli_parse_batch() shared by workers.
+struct CliBatchJob {
+    char** lines;
+    size_t count;
+    Cli* results;
+    enum CliError* errors;
+    // A next line that is not taken by a worker.
+    size_t next;
+};
+
+struct CliBatchWorker {
+    struct CliBatchJob* job;
+    pthread_t thread;
+    // The last slab is used by `arena`.
+    struct CliSlab* slabs;
+    CliArena arena;
+    enum CliError error;
+};
+
+// Allocate from the arena of a worker, starting a new slab if the current one is full.
+static void* cli_batch_alloc(void* ctx, size_t size) {
+    struct CliBatchWorker* worker = (struct CliBatchWorker*)ctx;
+    void* result = cli_arena_alloc(&worker->arena, size);
+    if (result) {
+        return result;
+    }
+
+    size_t slab_size = size > CLI_BATCH_SLAB_SIZE ? size : CLI_BATCH_SLAB_SIZE;
+    struct CliSlab* slab = (struct CliSlab*)CLI_MALLOC(CLI_SLAB_HEADER + slab_size);
+    if (slab == NULL) {
+        return NULL;
+    }
+    slab->next = worker->slabs;
+    worker->slabs = slab;
+    cli_arena_init(&worker->arena, (char*)slab + CLI_SLAB_HEADER, slab_size);
+    return cli_arena_alloc(&worker->arena, size);
+}
+
+static void* cli_batch_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    void* result = cli_batch_alloc(ctx, new_size);
+    if (result && ptr) {
+        memcpy(result, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return result;
+}
+
+static void* cli_batch_work(void* arg) {
+    struct CliBatchWorker* worker = (struct CliBatchWorker*)arg;
+    struct CliBatchJob* job = worker->job;
+    CliAllocator allocator = {
+        .ctx = worker, .alloc = cli_batch_alloc, .realloc = cli_batch_realloc, .free = cli_arena_free
+    };
+
+    while (true) {
+        size_t start = CLI_ATOMIC_ADD(&job->next, (size_t)CLI_BATCH_CHUNK);
+        if (start >= job->count) {
+            break;
+        }
+        size_t end = job->count - start > CLI_BATCH_CHUNK ? start + CLI_BATCH_CHUNK : job->count;
+        for (size_t i = start; i < end; i++) {
+            Cli* cli = &job->results[i];
+            memset(cli, 0, sizeof(*cli));
+            cli->allocator = allocator;
+            enum CliError error = cli_parse_line(job->lines[i], cli, true);
+            // The block belongs to the batch, so `cli` does not own it.
+            cli->allocator = cli_default_allocator();
+            cli->block = NULL;
+            cli->block_size = 0;
+#ifdef CLI_STATS
+            cli->stats.bytes = 0;
+#endif
+
+            if (job->errors) {
+                job->errors[i] = error;
+            }
+            if (error > worker->error) {
+                worker->error = error;
+            }
+        }
+    }
+    return NULL;
+}
+
+enum CliError cli_parse_batch(
+    CliBatch* batch, char** lines, size_t count, Cli* results, enum CliError* errors,
+    unsigned int threads
+) {
+    batch->slabs = NULL;
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+    // There is no reason to start more threads than chunks.
+    size_t chunks = (count + CLI_BATCH_CHUNK - 1) / CLI_BATCH_CHUNK;
+    if (threads > chunks) {
+        threads = chunks ? (unsigned int)chunks : 1;
+    }
+
+    struct CliBatchWorker* workers
+        = (struct CliBatchWorker*)CLI_MALLOC(threads * sizeof(struct CliBatchWorker));
+    if (workers == NULL) {
+        return CliErrorFatal;
+    }
+    struct CliBatchJob job;
+    job.lines = lines;
+    job.count = count;
+    job.results = results;
+    job.errors = errors;
+    job.next = 0;
+    memset(workers, 0, threads * sizeof(struct CliBatchWorker));
+    for (unsigned int i = 0; i < threads; i++) {
+        workers[i].job = &job;
+    }
+
+    // The calling thread is the first worker. If a thread cannot be started, other workers take
+    // its lines.
+    unsigned int started = 1;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started].thread, NULL, cli_batch_work, &workers[started])) {
+            break;
+        }
+    }
+    cli_batch_work(&workers[0]);
+
+    enum CliError result = CliErrorOk;
+    for (unsigned int i = 0; i < started; i++) {
+        if (i) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        struct CliSlab** tail = &workers[i].slabs;
+        while (*tail) {
+            tail = &(*tail)->next;
+        }
+        *tail = batch->slabs;
+        batch->slabs = workers[i].slabs;
+        // Memory errors are more important than user errors.
+        if (workers[i].error > result) {
+            result = workers[i].error;
+        }
+    }
+    CLI_FREE(workers);
+    return result;
+}
+
+void cli_free_batch(CliBatch* batch) {
+    while (batch->slabs) {
+        struct CliSlab* next = batch->slabs->next;
+        CLI_FREE(batch->slabs);
+        batch->slabs = next;
+    }
+}
+#endif // CLI_BATCH
+
+void cli_reset(Cli* cli) {
+#ifdef CLI_RESPONSE_FILES
+    cli_unmap_response_files(cli);
+#endif
+#ifdef CLI_LAYERS
+    cli_free_layers(cli);
+#endif
+#ifdef CLI_STREAM
+    cli_free_chunks(cli, NULL);
+#endif
+    Cli kept = *cli;
+    memset(cli, 0, sizeof(*cli));
+    cli->execfile = kept.execfile;
+    cli->allocator = kept.allocator;
+    cli->block = kept.block;
+    cli->block_size = kept.block_size;
+#ifdef CLI_STATS
+    cli->stats = kept.stats;
+#endif
+}
+#endif // CLI_NOHEAP
+
+const CliCommand*
+cli_find_command(const CliCommand* commands, size_t count, const char* name, size_t* matches) {
+    // Commands in [low, high) start with the first `i` characters of `name`, so they are sorted by
+    // their next characters. Each character narrows the range with two binary searches.
+    size_t low = 0;
+    size_t high = count;
+    size_t i = 0;
+    for (; name[i] != '\0' && low < high; i++) {
+        unsigned char c = (unsigned char)name[i];
+        size_t left = low;
+        size_t right = high;
+        while (left < right) {
+            size_t middle = left + (right - left) / 2;
+            if ((unsigned char)commands[middle].name[i] < c) {
+                left = middle + 1;
+            } else {
+                right = middle;
+            }
+        }
+        low = left;
+        right = high;
+        while (left < right) {
+            size_t middle = left + (right - left) / 2;
+            if ((unsigned char)commands[middle].name[i] <= c) {
+                left = middle + 1;
+            } else {
+                right = middle;
+            }
+        }
+        high = left;
+    }
+
+    // An exact match is shorter than other commands in the range, so it is the first one.
+    if (low < high && commands[low].name[i] == '\0') {
+        high = low + 1;
+    }
+    if (matches) {
+        *matches = high - low;
+    }
+    return high - low == 1 ? &commands[low] : NULL;
+}
+
+// The last table checked by cli_dispatch(), so a static table is only checked by the first call.
+static const CliCommand* cli_sorted_commands;
+
+static inline bool cli_are_commands_sorted(const CliCommand* commands, size_t count) {
+    if (CLI_ATOMIC_LOAD(&cli_sorted_commands) == commands) {
+        return true;
+    }
+    for (size_t i = 1; i < count; i++) {
+        if (strcmp(commands[i - 1].name, commands[i].name) >= 0) {
+            return false;
+        }
+    }
+    CLI_ATOMIC_STORE(&cli_sorted_commands, commands);
+    return true;
+}
+
+// Indexes of up to this many slots (32 options) are kept on the stack of cli_dispatch().
+#define CLI_DISPATCH_INDEX_SIZE 64
+
+int cli_dispatch(Cli* cli, const CliCommand* commands, size_t count, void* ctx) {
+    CLI_ASSERT(
+        cli_are_commands_sorted(commands, count)
+        && "Commands of cli_dispatch() should be sorted by name."
+    );
+    if (cli->args.length == 0) {
+        cli_print_error("CLI error", "A command is not specified.");
+        return CliErrorUser;
+    }
+
+    const char* name = cli_at(cli->args, 0);
+    size_t matches;
+    const CliCommand* found = cli_find_command(commands, count, name, &matches);
+    if (found == NULL) {
+        if (matches) {
+            cli_printf_error(
+                "CLI error", "A command ('%s') is ambiguous: %zu commands start with it.", name,
+                matches
+            );
+        } else {
+            cli_printf_error("CLI error", "Unknown command ('%s').", name);
+        }
+        return CliErrorUser;
+    }
+
+    // The command shares arrays of `cli`, but none of its resources.
+    Cli command = *cli;
+    command.execfile = found->name;
+    command.args.data = cli->args.data + 1;
+    command.args.length = cli->args.length - 1;
+    command.program_options = cli->cmd_options;
+    memset(&command.cmd_options, 0, sizeof(command.cmd_options));
+#ifndef CLI_NOHEAP
+    command.args.capacity = command.args.length;
+    command.block = NULL;
+    command.block_size = 0;
+#endif
+#ifdef CLI_RESPONSE_FILES
+    command.mappings = NULL;
+#endif
+#ifdef CLI_LAYERS
+    command.layers = NULL;
+#endif
+#ifdef CLI_STREAM
+    command.chunks = NULL;
+#endif
+#ifdef CLI_STATS
+    memset(&command.stats, 0, sizeof(command.stats));
+#endif
+#ifdef CLI_SHORT_FLAGS
+    memset(command.short_flags, 0, sizeof(command.short_flags));
+    for (size_t i = 0; i < command.program_options.length; i++) {
+        cli_add_short_flags(&command, cli_at(command.program_options, i));
+    }
+#endif
+#ifdef CLI_INDEX
+    // A small index is kept on the stack. A larger one is the only block of the command, so
+    // cli_free() releases it.
+    unsigned int stack_index[CLI_DISPATCH_INDEX_SIZE];
+    size_t index_capacity = cli_index_capacity(command.program_options.length);
+    if (index_capacity <= CLI_DISPATCH_INDEX_SIZE) {
+        command.index = stack_index;
+    } else {
+        command.block = cli_allocate(&command, index_capacity * sizeof(unsigned int));
+        if (command.block == NULL) {
+            cli_print_error("Memory error", "Unable to allocate memory for a command index.");
+            return CliErrorFatal;
+        }
+        command.block_size = index_capacity * sizeof(unsigned int);
+        command.index = (unsigned int*)command.block;
+    }
+    memset(command.index, 0, index_capacity * sizeof(unsigned int));
+    command.index_mask = (unsigned int)index_capacity - 1;
+    cli_index_build(&command);
+#endif
+
+    int result = (found->run)(cli, &command, ctx);
+    cli_free(&command);
+    return result;
+}
+
+size_t cli_argv_capacity(const Cli* cli, size_t edit_count) {
+    // The executable file, a double dash and the NULL are added to arrays and edits.
+    return 3 + cli->program_options.length + cli->args.length + cli->cmd_options.length
+         + edit_count;
+}
+
+// Check whether an option `arg` is named `name` (e.g. `--threads=4` is `--threads`).
+static bool cli_is_named(const char* arg, const char* name) {
+    size_t length = strlen(name);
+    return strncmp(arg, name, length) == 0 && (arg[length] == '\0' || arg[length] == '=');
+}
+
+size_t cli_build_argv(
+    const Cli* cli, const CliEdit* edits, size_t edit_count, char** argv, size_t capacity
+) {
+    CLI_ASSERT(cli->execfile && "cli_build_argv() requires the executable file.");
+    if (capacity < cli_argv_capacity(cli, edit_count)) {
+        return 0;
+    }
+    for (size_t i = 0; i < cli->args.length; i++) {
+        if (cli_at(cli->args, i)[0] == '-') {
+            return 0;
+        }
+    }
+
+    // execv() and posix_spawn() take `char* const*`, but do not modify arguments.
+    size_t argc = 0;
+    argv[argc++] = (char*)cli->execfile;
+    for (size_t i = 0; i < cli->program_options.length; i++) {
+        const char* option = cli_at(cli->program_options, i);
+        bool is_removed = false;
+        for (size_t j = 0; j < edit_count && !is_removed; j++) {
+            is_removed = edits[j].name && cli_is_named(option, edits[j].name);
+        }
+        if (!is_removed) {
+            argv[argc++] = (char*)option;
+        }
+    }
+    for (size_t j = 0; j < edit_count; j++) {
+        if (edits[j].arg) {
+            argv[argc++] = (char*)edits[j].arg;
+        }
+    }
+
+    // Without positional arguments, only a double dash makes next options command options.
+    if (cli->args.length == 0 && cli->cmd_options.length) {
+        argv[argc++] = (char*)"--";
+    }
+    for (size_t i = 0; i < cli->args.length; i++) {
+        argv[argc++] = (char*)cli_at(cli->args, i);
+    }
+    for (size_t i = 0; i < cli->cmd_options.length; i++) {
+        argv[argc++] = (char*)cli_at(cli->cmd_options, i);
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+#ifdef CLI_STATS
+void cli_stats_dump(const Cli* cli) {
+    const CliStats* stats = &cli->stats;
+    cli_printf_info(
+        "CLI stats",
+        "%zu allocations, %zu reallocations, %zu bytes (%zu at peak), %llu ns, %zu program "
+        "options, %zu args, %zu cmd options.",
+        stats->allocations, stats->reallocations, stats->bytes, stats->peak_bytes, stats->parse_ns,
+        (size_t)cli->program_options.length, (size_t)cli->args.length,
+        (size_t)cli->cmd_options.length
+    );
+}
+#endif // CLI_STATS
+
+inline void cli_free(Cli* cli) {
+#ifdef CLI_NOHEAP
+    (void)cli;
+#else
+    if (cli->block) {
+        cli_release(cli, cli->block, cli->block_size);
+    }
+#ifdef CLI_RESPONSE_FILES
+    cli_unmap_response_files(cli);
+#endif
+#ifdef CLI_LAYERS
+    cli_free_layers(cli);
+#endif
+#ifdef CLI_STREAM
+    cli_free_chunks(cli, NULL);
+#endif
+    const char* execfile = cli->execfile;
+    CliAllocator allocator = cli->allocator;
+    memset(cli, 0, sizeof(*cli));
+    cli->execfile = execfile;
+    cli->allocator = allocator;
 #endif // CLI_NOHEAP || CLI_NOHEAP_IMPLEMENTATION
 }
 
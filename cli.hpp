@@ -0,0 +1,394 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2024 Arisu Wonderland
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// A C++20 wrapper of cli.h: ownership of parsed arguments, views of arrays that
+// do not copy arguments and option schemas that are matched at compile time.
+//
+// Macros of cli.h (including CLI_IMPLEMENTATION) are defined before including
+// the file, in the same way as for cli.h:
+//     #define CLI_IMPLEMENTATION
+//     #include "cli.hpp"
+//
+// Example:
+//
+//     using AppOptions = cli::Schema<
+//         cli::Flag<"-v", "--verbose", "Print more messages">,
+//         cli::Value<"-j", "--threads", "Number of threads">>;
+//
+//     int main(int argc, char** argv) {
+//         cli::CommandLine cli(argc, argv);
+//         AppOptions options;
+//
+//         if (!cli || options.parse(cli)) {
+//             return 1;
+//         }
+//         if (options.get<"--verbose">()) {
+//             for (std::string_view arg : cli.args()) {
+//                 // ...
+//             }
+//         }
+//     }
+
+#ifndef __CLI_HPP_
+#define __CLI_HPP_
+
+#include "cli.h"
+
+#ifdef CLI_NOHEAP
+#error "cli.hpp owns the heap block of cli_parse() and cannot be used with CLI_NOHEAP."
+#endif
+
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace cli {
+
+// A random-access range over `CliArray.data` that yields arguments as std::string_view. Only
+// pointers are stored, and a length of an argument is counted when it is accessed.
+class ArgView {
+#ifdef CLI_COMPACT
+    using Base = const char*;
+#else
+    // Items are pointers already.
+    struct Base {};
+#endif
+
+    static const char* arg(const CliItem* item, [[maybe_unused]] Base base) noexcept {
+#ifdef CLI_COMPACT
+        return base + *item;
+#else
+        return *item;
+#endif
+    }
+
+public:
+    class Iterator {
+    public:
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::string_view;
+
+        constexpr Iterator() noexcept = default;
+        constexpr Iterator(const CliItem* item, Base base) noexcept : item_(item), base_(base) {}
+
+        std::string_view operator*() const noexcept { return arg(item_, base_); }
+        std::string_view operator[](difference_type n) const noexcept {
+            return arg(item_ + n, base_);
+        }
+
+        Iterator& operator++() noexcept { return ++item_, *this; }
+        Iterator operator++(int) noexcept { return Iterator(item_++, base_); }
+        Iterator& operator--() noexcept { return --item_, *this; }
+        Iterator operator--(int) noexcept { return Iterator(item_--, base_); }
+        Iterator& operator+=(difference_type n) noexcept { return item_ += n, *this; }
+        Iterator& operator-=(difference_type n) noexcept { return item_ -= n, *this; }
+
+        friend Iterator operator+(Iterator it, difference_type n) noexcept { return it += n; }
+        friend Iterator operator+(difference_type n, Iterator it) noexcept { return it += n; }
+        friend Iterator operator-(Iterator it, difference_type n) noexcept { return it -= n; }
+        friend difference_type operator-(Iterator a, Iterator b) noexcept {
+            return a.item_ - b.item_;
+        }
+        friend bool operator==(Iterator a, Iterator b) noexcept { return a.item_ == b.item_; }
+        friend auto operator<=>(Iterator a, Iterator b) noexcept { return a.item_ <=> b.item_; }
+
+    private:
+        const CliItem* item_ = nullptr;
+        [[no_unique_address]] Base base_ {};
+    };
+
+    constexpr ArgView() noexcept = default;
+    explicit ArgView(const CliArray& array) noexcept
+        : data_(array.length ? array.data : nullptr), size_(array.length) {
+#ifdef CLI_COMPACT
+        base_ = array.base;
+#endif
+    }
+
+    Iterator begin() const noexcept { return Iterator(data_, base_); }
+    Iterator end() const noexcept { return Iterator(data_ + size_, base_); }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    std::string_view operator[](std::size_t i) const noexcept { return arg(data_ + i, base_); }
+    std::string_view front() const noexcept { return arg(data_, base_); }
+    std::string_view back() const noexcept { return arg(data_ + size_ - 1, base_); }
+
+    // Items of the array, e.g. for C functions (offsets with CLI_COMPACT, see cli_at()).
+    std::span<const CliItem> raw() const noexcept { return { data_, size_ }; }
+
+private:
+    const CliItem* data_ = nullptr;
+    std::size_t size_ = 0;
+    [[no_unique_address]] Base base_ {};
+};
+
+// Parsed arguments of cli_parse() that are released by the destructor.
+class CommandLine {
+public:
+    // Parse the command line. If it is invalid, an error is printed and the object is false.
+    CommandLine(int argc, char** argv) noexcept : error_(cli_parse(argc, argv, &cli_)) {}
+
+    CommandLine(int argc, char** argv, const CliAllocator& allocator) noexcept
+        : error_(cli_parse_ex(argc, argv, &cli_, &allocator)) {}
+
+    CommandLine(const CommandLine&) = delete;
+    CommandLine& operator=(const CommandLine&) = delete;
+
+    CommandLine(CommandLine&& other) noexcept : cli_(other.cli_), error_(other.error_) {
+        other.error_ = CliErrorFatal;
+    }
+
+    CommandLine& operator=(CommandLine&& other) noexcept {
+        if (this != &other) {
+            release();
+            cli_ = other.cli_;
+            error_ = other.error_;
+            other.error_ = CliErrorFatal;
+        }
+        return *this;
+    }
+
+    ~CommandLine() { release(); }
+
+    // True if the command line is parsed.
+    explicit operator bool() const noexcept { return error_ == CliErrorOk; }
+    CliError error() const noexcept { return error_; }
+
+    std::string_view execfile() const noexcept { return cli_.execfile ? cli_.execfile : ""; }
+    ArgView args() const noexcept { return ArgView(cli_.args); }
+    ArgView program_options() const noexcept { return ArgView(cli_.program_options); }
+    ArgView cmd_options() const noexcept { return ArgView(cli_.cmd_options); }
+
+    // The underlying `Cli` for functions of cli.h. It should not be freed.
+    Cli& get() noexcept { return cli_; }
+    const Cli& get() const noexcept { return cli_; }
+
+#ifdef CLI_INDEX
+    // See cli_get_option().
+    std::optional<std::string_view> option(const char* name) const noexcept {
+        return to_optional(cli_get_option(&cli_, name));
+    }
+
+    // See cli_get_cmd_option().
+    std::optional<std::string_view> cmd_option(const char* name) const noexcept {
+        return to_optional(cli_get_cmd_option(&cli_, name));
+    }
+
+    bool has_flag(const char* name) const noexcept { return cli_has_flag(&cli_, name); }
+    bool has_cmd_flag(const char* name) const noexcept { return cli_has_cmd_flag(&cli_, name); }
+#endif // CLI_INDEX
+
+private:
+    void release() noexcept {
+        if (error_ == CliErrorOk) {
+            cli_free(&cli_);
+            error_ = CliErrorFatal;
+        }
+    }
+
+    static std::optional<std::string_view> to_optional(const char* value) noexcept {
+        return value ? std::optional<std::string_view>(value) : std::nullopt;
+    }
+
+    Cli cli_;
+    CliError error_;
+};
+
+// A string literal as a template argument, e.g. "--verbose" of `cli::Flag<"-v", "--verbose">`.
+template <std::size_t N>
+struct Name {
+    char data[N] {};
+
+    constexpr Name(const char (&literal)[N]) noexcept {
+        for (std::size_t i = 0; i < N; i++) {
+            data[i] = literal[i];
+        }
+    }
+
+    constexpr std::string_view view() const noexcept { return { data, N - 1 }; }
+};
+
+enum class Kind {
+    Flag,
+    Value
+};
+
+// An option of `cli::Schema`. Use "" if the option has no short or long name.
+template <Name Short, Name Long, Kind K, Name Help = "">
+struct Option {
+    static constexpr std::string_view short_name = Short.view();
+    static constexpr std::string_view long_name = Long.view();
+    static constexpr std::string_view help = Help.view();
+    static constexpr Kind kind = K;
+
+    // `bool` for flags (they cannot have a value) and a value after '=' for options that
+    // require a value.
+    using value_type
+        = std::conditional_t<K == Kind::Flag, bool, std::optional<std::string_view>>;
+
+    static_assert(!short_name.empty() || !long_name.empty(), "An option should have a name.");
+    static_assert(
+        short_name.empty()
+            || (short_name.size() > 1 && short_name[0] == '-' && short_name[1] != '-'),
+        "A short name should start with a single dash (e.g. \"-v\")."
+    );
+    static_assert(
+        long_name.empty() || (long_name.size() > 2 && long_name.starts_with("--")),
+        "A long name should start with two dashes (e.g. \"--verbose\")."
+    );
+
+    // Names have constant lengths, so most options are rejected by comparing a length.
+    static constexpr bool matches(std::string_view name) noexcept {
+        return (!short_name.empty() && name == short_name)
+            || (!long_name.empty() && name == long_name);
+    }
+};
+
+template <Name Short, Name Long, Name Help = "">
+using Flag = Option<Short, Long, Kind::Flag, Help>;
+
+template <Name Short, Name Long, Name Help = "">
+using Value = Option<Short, Long, Kind::Value, Help>;
+
+// Why cli::Schema::parse() failed (see `enum CliSchemaError`).
+enum class SchemaError {
+    None,
+    Unknown,
+    Value,
+    NoValue
+};
+
+/*
+ * Known program options, similarly to CLI_SCHEMA() of cli.h. Each option is
+ * a `cli::Flag` or a `cli::Value`, and values are read by names:
+ *     options.get<"--threads">() // or options.get<"-j">()
+ *
+ * Matching is generated for every option at compile time, and an unknown name
+ * of get() does not compile.
+ */
+template <class... Options>
+class Schema {
+public:
+    static constexpr std::size_t size = sizeof...(Options);
+
+    /*
+     * Match program options of `cli`. Values point to arguments of `cli`, so
+     * `cli` should outlive the schema.
+     *
+     * If a program option is not listed or has a wrong kind, no error is
+     * printed: CliErrorUser is returned, and error() and error_option() tell
+     * the reason.
+     */
+    CliError parse(const CommandLine& cli) noexcept {
+        values_ = {};
+        error_ = SchemaError::None;
+        error_option_ = {};
+
+        for (std::string_view arg : cli.program_options()) {
+            std::size_t end = arg.find('=');
+            std::optional<std::string_view> value;
+            if (end != std::string_view::npos) {
+                value = arg.substr(end + 1);
+            }
+            if (!match(arg.substr(0, end), value, std::index_sequence_for<Options...> {})) {
+                error_ = SchemaError::Unknown;
+            }
+            if (error_ != SchemaError::None) {
+                error_option_ = arg;
+                return CliErrorUser;
+            }
+        }
+        return CliErrorOk;
+    }
+
+    template <Name N>
+    const auto& get() const noexcept {
+        constexpr std::size_t i = index_of(N.view());
+        static_assert(i < size, "The option is not in the schema.");
+        return std::get<i>(values_);
+    }
+
+    SchemaError error() const noexcept { return error_; }
+    std::string_view error_option() const noexcept { return error_option_; }
+
+private:
+    static constexpr std::size_t index_of(std::string_view name) noexcept {
+        constexpr std::array<std::string_view, size> short_names { Options::short_name... };
+        constexpr std::array<std::string_view, size> long_names { Options::long_name... };
+        for (std::size_t i = 0; i < size; i++) {
+            if (!name.empty() && (name == short_names[i] || name == long_names[i])) {
+                return i;
+            }
+        }
+        return size;
+    }
+
+    template <std::size_t... I>
+    bool match(
+        std::string_view name, std::optional<std::string_view> value, std::index_sequence<I...>
+    ) noexcept {
+        return (match_option<I>(name, value) || ...);
+    }
+
+    template <std::size_t I>
+    bool match_option(std::string_view name, std::optional<std::string_view> value) noexcept {
+        using O = std::tuple_element_t<I, std::tuple<Options...>>;
+        if (!O::matches(name)) {
+            return false;
+        }
+
+        if constexpr (O::kind == Kind::Flag) {
+            if (value) {
+                error_ = SchemaError::Value;
+            } else {
+                std::get<I>(values_) = true;
+            }
+        } else {
+            if (value) {
+                std::get<I>(values_) = value;
+            } else {
+                error_ = SchemaError::NoValue;
+            }
+        }
+        return true;
+    }
+
+    std::tuple<typename Options::value_type...> values_ {};
+    SchemaError error_ = SchemaError::None;
+    std::string_view error_option_;
+};
+
+} // namespace cli
+
+#endif // __CLI_HPP_